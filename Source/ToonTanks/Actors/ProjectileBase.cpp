@@ -38,10 +38,29 @@
 #include "DrawDebugHelpers.h"
 #include "Projects.h"
 #include "Engine/TriggerSphere.h"
+#include "GameFramework/PlayerController.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Kismet/GameplayStatics.h"
-#include "ToonTanks/Pawns/PawnTank.h"
-#include "ToonTanks/Pawns/PawnTurret.h"
+#include "ToonTanks/Pawns/PawnBase.h"
+#include "ToonTanks/Subsystems/AudioEventSubsystem.h"
+#include "ToonTanks/Subsystems/EffectsSubsystem.h"
+#include "ToonTanks/Subsystems/ExplosionSubsystem.h"
+#include "ToonTanks/Subsystems/ProjectilePoolSubsystem.h"
+#include "ToonTanks/Subsystems/SignificanceSubsystem.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/Subsystems/WeaponDefinitionSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<float> CVarProjectileRepeatedHitWindow(
+	TEXT("ToonTanks.Projectiles.RepeatedHitWindow"),
+	0.25f,
+	TEXT("Hits on the same non-pawn component less than this many seconds apart (a grenade rolling along the floor) are ignored."));
+
+static TAutoConsoleVariable<float> CVarProjectileImpactSoundCooldown(
+	TEXT("ToonTanks.Projectiles.ImpactSoundCooldown"),
+	1.f,
+	TEXT("Seconds before the same projectile can play another impact sound."));
 
 // Sets default values
 AProjectileBase::AProjectileBase()
@@ -55,15 +74,18 @@ AProjectileBase::AProjectileBase()
 	// Since UProjectileMovementComponent isn't a tangible thing to be part of the scene,
 	// it doesn't need to attach to anything like the root component, like other solids do.
 	ProjectileMovement = CreateDefaultSubobject<UProjectileMovementComponent>(TEXT("Projectile Movement"));
+	// The real numbers come from our weapon in ActivateFromPool(), these are just so the editor previews look right.
 	ProjectileMovement->InitialSpeed = MoveSpeedStart;
 	ProjectileMovement->MaxSpeed = MoveSpeedMax;
-	// How long the particle lives if nothing else destroys it before this.
-	InitialLifeSpan = LifeSpan * 2;
+	// No InitialLifeSpan here, since that would Destroy() us and we want to go back to the pool instead.
+	// See LifeSpanTimerHandle in ActivateFromPool().
 
 	// This binds "OnComponentHit" event to "OnHit()" function, so OnHit is called any time this component is hit.
 	// AddDynamic() is a helper macro that binds the event to the object and method we want to call.
 	ProjectileMesh->OnComponentHit.AddDynamic(this, &AProjectileBase::OnHit);
 
+	// Projectiles are never replicated. Clients launch their own from APawnBase::MulticastFireProjectile().
+	bReplicates = false;
 }
 
 // *** See comments at top of file. ***
@@ -71,65 +93,145 @@ AProjectileBase::AProjectileBase()
 void AProjectileBase::OnHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp,
 	FVector NormalImpulse, const FHitResult& Hit)
 {
-	AActor* MyOwner = GetOwner();
-
-	if (!MyOwner) {
+	// A rolling grenade hits the floor every frame. Those are all the same bounce as far as we're concerned,
+	// so drop them before doing anything else (the explosion timer keeps counting from the first one).
+	const float Now = USimulationClockSubsystem::GetGameplayTime(GetWorld());
+	const bool IsSameComponent = OtherComp && LastHitComponent.Get() == OtherComp;
+	if (IsSameComponent && LastHitTags == EPawnTags::None
+		&& Now - LastHitTime < GetRepeatedHitWindow()) {
+		LastHitTime = Now;
+		TOONTANKS_COUNT(RepeatedHitsFiltered, 1);
 		return;
 	}
 
-	// If we hit another actor:
-	if (OtherActor) {
-		// We can first check if the other actor is a PawnTurret or PawnTank, and save it as a bool.
-		IsTurret = OtherActor->GetClass()->IsChildOf(APawnTurret::StaticClass());
-		IsTank = OtherActor->GetClass()->IsChildOf(APawnTank::StaticClass());
+	TOONTANKS_SCOPE_CYCLE(ProjectileOnHit);
+
+	// Only classify what we hit when it's something new, a bit mask tells us what kind of pawn (if any) it is.
+	if (!IsSameComponent) {
+		LastHitComponent = OtherComp;
+		LastHitTags = APawnBase::GetTagsOf(OtherActor);
+	}
+	LastHitTime = Now;
+	const bool IsTurret = EnumHasAnyFlags(LastHitTags, EPawnTags::Turret);
+	const bool IsTank = EnumHasAnyFlags(LastHitTags, EPawnTags::Tank);
+	const bool IsDamageable = EnumHasAnyFlags(LastHitTags, EPawnTags::Damageable);
+
+	AActor* MyOwner = GetOwner();
+
+	// No owner means we're sitting in the pool (or our shooter is gone).
+	if (!MyOwner || !IsInFlight) {
+		return;
 	}
 
 	// So if we hit a turret or the player, but not ourselves.
-	if (IsTurret || IsTank && OtherActor != GetOwner()) {
+	// A client's projectile is just for show, the server's copy of it does the damage.
+	if (IsDamageable && (IsTurret || (IsTank && OtherActor != GetOwner())) && !IsCosmetic()) {
 		// Play hit particle.
-		UGameplayStatics::SpawnEmitterAtLocation(this, HitParticle, GetActorLocation());
+		SpawnEffect(HitParticle);
 		// PLay metal impact sound when hit directly.
-		PlaySoundNoSpam(DirectImpactSound);
+		PlayImpactSound(DirectImpactSound, ToonTanksSoundPriority::DirectImpact);
 
 		// Generate and apply the damage.
 		UGameplayStatics::ApplyDamage(
 			OtherActor,							// Actor that will be damaged.
-			Damage,								// Damage amount.
+			GetWeapon().Damage,					// Damage amount.
 			MyOwner->GetInstigatorController(),	// Which player instigated it.
 			this,								// What actor caused the damage.
 			DamageType							// Type of damage done.
 			);
-		DestroyProjectile();
 	}
 
-	// Shake Camera if it's the player hit.
-	if (IsTank) {
-		GetWorld()->GetFirstPlayerController()->ClientStartCameraShake(HitShake, HitShakeScale);
+	// Shake Camera of whoever's driving the tank we hit. It's a client RPC, so the server's enough.
+	if (IsTank && !IsCosmetic()) {
+		APawn* HitPawn = Cast<APawn>(OtherActor);
+		if (APlayerController* PlayerController = HitPawn ? Cast<APlayerController>(HitPawn->GetController()) : nullptr) {
+			PlayerController->ClientStartCameraShake(HitShake, HitShakeScale);
+		}
+	}
+
+	// Any pawn hit means we explode right away. We're back in the pool after this, so we're done here.
+	if (IsTurret || IsTank) {
 		DestroyProjectile();
+		return;
 	}
 
 	// Play this sound whenever we bounce off anything.
-	PlaySoundNoSpam(ImpactSound);
+	PlayImpactSound(ImpactSound, ToonTanksSoundPriority::Impact);
 
-	// Then explode the grenade after ExplosionTimer seconds, via a Timer.
+	// Then explode the grenade after ExplosionTimer seconds, via a Timer (or our fixed steps).
+	if (SimulationClock) {
+		FuseTimeLeft = GetWeapon().ExplosionTimer;
+		return;
+	}
 	GetWorld()->GetTimerManager().SetTimer(
 		OUT ExplosionTimerHandle,
 		this,
 		&AProjectileBase::DestroyProjectile,
-		ExplosionTimer,
+		GetWeapon().ExplosionTimer,
 		false
 		);
 }
 
+/// Falls back to the default weapon if there's no weapon subsystem (like in an editor preview).
+const FWeaponDefinition& AProjectileBase::GetWeapon() const
+{
+	static const FWeaponDefinition DefaultWeapon;
+	const UWeaponDefinitionSubsystem* Weapons = GetWorld() ? GetWorld()->GetSubsystem<UWeaponDefinitionSubsystem>() : nullptr;
+	return Weapons ? Weapons->GetWeapon(WeaponId) : DefaultWeapon;
+}
+
+/// Always off the class default object, whichever projectile asks. The fuse and splash were never
+/// per-projectile, so those keep the default weapon's values.
+FWeaponDefinition AProjectileBase::GetFallbackWeapon() const
+{
+	const AProjectileBase* Defaults = GetClass()->GetDefaultObject<AProjectileBase>();
+	FWeaponDefinition Weapon;
+	Weapon.Damage = Defaults->Damage;
+	Weapon.MoveSpeedStart = Defaults->MoveSpeedStart;
+	Weapon.MoveSpeedMax = Defaults->MoveSpeedMax;
+	Weapon.LifeSpan = Defaults->LifeSpan;
+	Weapon.ImpulseRadius = Defaults->ImpulseRadius;
+	Weapon.ImpulseForce = Defaults->ImpulseForce;
+	return Weapon;
+}
+
+/// Play sound effect at our location through the AudioEventSubsystem. \n
+/// It stops the same sound spamming from the same spot (like a grenade rolling on the ground),
+/// and keeps us inside the voice budget when lots of grenades are going off.
+void AProjectileBase::PlaySound(USoundBase* SoundToPlay, float Priority)
+{
+	if (UAudioEventSubsystem* AudioEvents = GetWorld()->GetSubsystem<UAudioEventSubsystem>()) {
+		AudioEvents->PlaySoundAtLocation(SoundToPlay, GetActorLocation(), Priority);
+	}
+}
+
 /// Play sound effect at location, with a cooldown.
-void AProjectileBase::PlaySoundNoSpam(USoundBase* SoundToPlay)
+void AProjectileBase::PlayImpactSound(USoundBase* SoundToPlay, float Priority)
 {
 	// This is so the hit sound doesn't spam when rolling against the ground.
-	WorldTime = UGameplayStatics::GetTimeSeconds(GetWorld());
-	float Cooldown = WorldTime - TimeHitSoundPlayed;
-	if (Cooldown >= 1) {
+	const float WorldTime = USimulationClockSubsystem::GetGameplayTime(GetWorld());
+	if (WorldTime - TimeHitSoundPlayed >= GetImpactSoundCooldown()) {
 		TimeHitSoundPlayed = WorldTime;
-		UGameplayStatics::PlaySoundAtLocation(this, SoundToPlay, GetActorLocation());
+		PlaySound(SoundToPlay, Priority);
+	}
+}
+
+float AProjectileBase::GetImpactSoundCooldown()
+{
+	return CVarProjectileImpactSoundCooldown.GetValueOnGameThread();
+}
+
+float AProjectileBase::GetRepeatedHitWindow()
+{
+	return CVarProjectileRepeatedHitWindow.GetValueOnGameThread();
+}
+
+/// Spawn a particle effect at our location through the EffectsSubsystem. \n
+/// Off screen effects are skipped, and effects on top of each other (a whole volley exploding at once) merge.
+void AProjectileBase::SpawnEffect(UParticleSystem* Effect)
+{
+	if (UEffectsSubsystem* Effects = GetWorld()->GetSubsystem<UEffectsSubsystem>()) {
+		Effects->SpawnEffect(Effect, GetActorLocation());
 	}
 }
 
@@ -137,53 +239,192 @@ void AProjectileBase::PlaySoundNoSpam(USoundBase* SoundToPlay)
 void AProjectileBase::BeginPlay()
 {
 	Super::BeginPlay();
-	UGameplayStatics::PlaySoundAtLocation(this, LaunchSound, GetActorLocation());
+	// The launch sound is played in ActivateFromPool(), since BeginPlay only happens once per pooled actor.
 }
 
-/// Play explosion particle effect then destroy this projectile.
+/// Reset everything left over from our last flight, then launch from Location towards Rotation.
+void AProjectileBase::ActivateFromPool(const FVector& Location, const FRotator& Rotation, AActor* NewOwner)
+{
+	// Setting the owner helps, for example, down the line to ensure we don't shoot ourselves.
+	SetOwner(NewOwner);
+	SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::ResetPhysics);
+
+	LastHitComponent = nullptr;
+	LastHitTags = EPawnTags::None;
+	LastHitTime = 0;
+	TimeHitSoundPlayed = 0;
+	IsInFlight = true;
+
+	// Weapon ids never change once handed out, even when the table is reloaded, so we only look ours up once.
+	// Speeds are set every launch though, so a reloaded table takes effect on the very next shot.
+	UWeaponDefinitionSubsystem* Weapons = GetWorld()->GetSubsystem<UWeaponDefinitionSubsystem>();
+	if (Weapons && WeaponId == INDEX_NONE) {
+		WeaponId = Weapons->FindWeaponId(GetClass()->GetDefaultObject<AProjectileBase>());
+	}
+	const FWeaponDefinition& Weapon = GetWeapon();
+	ProjectileMovement->InitialSpeed = Weapon.MoveSpeedStart;
+	ProjectileMovement->MaxSpeed = Weapon.MoveSpeedMax;
+
+	SetActorHiddenInGame(false);
+	SetActorEnableCollision(true);
+
+	// ProjectileMovement lets go of its UpdatedComponent when it comes to a stop, so hook it back up.
+	// Then give it the same forward velocity it would've had from InitialSpeed on a fresh spawn.
+	ProjectileMovement->SetUpdatedComponent(ProjectileMesh);
+	ProjectileMovement->Velocity = GetActorForwardVector() * ProjectileMovement->InitialSpeed;
+	ProjectileMovement->UpdateComponentVelocity();
+	ProjectileMovement->Activate(true);
+
+	// On a fixed timestep the server's projectiles fly in the simulation steps, like the pawns that fire them.
+	// Clients' are just for show, so they keep flying with the frame.
+	USimulationClockSubsystem* Clock = GetWorld()->GetSubsystem<USimulationClockSubsystem>();
+	if (Clock && Clock->IsFixedStep() && !IsCosmetic()) {
+		SimulationClock = Clock;
+		ProjectileMovement->SetComponentTickEnabled(false);
+		SimulationStepHandle = SimulationClock->OnStep.AddUObject(this, &AProjectileBase::SimulationStep);
+	}
+	FuseTimeLeft = -1;
+
+	// Far from every player we take bigger steps and use a lower LOD. This also sets our first tier.
+	if (USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>()) {
+		Significance->RegisterProjectile(this);
+	}
+
+	// How long the projectile lives if nothing else recycles it before this.
+	if (SimulationClock) {
+		LifeSpanLeft = Weapon.LifeSpan * 2;
+	}
+	else {
+		GetWorldTimerManager().SetTimer(
+			OUT LifeSpanTimerHandle,
+			this,
+			&AProjectileBase::ReturnToPool,
+			Weapon.LifeSpan * 2,
+			false
+			);
+	}
+
+	PlaySound(LaunchSound, ToonTanksSoundPriority::Launch);
+}
+
+/// Stop moving, stop any pending explosion, and hide until the pool hands us out again.
+void AProjectileBase::DeactivateToPool()
+{
+	IsInFlight = false;
+	GetWorldTimerManager().ClearAllTimersForObject(this);
+	StopSimulationSteps();
+	if (USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>()) {
+		Significance->UnregisterProjectile(this);
+	}
+
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	SetOwner(nullptr);
+}
+
+/// Play explosion particle effect then send this projectile back to the pool.
 void AProjectileBase::DestroyProjectile()
 {
-	UGameplayStatics::PlaySoundAtLocation(this, ExplosionSound, GetActorLocation());
-	UGameplayStatics::SpawnEmitterAtLocation(this, ExplosionParticle, GetActorLocation());
+	// Both a direct hit and the explosion timer can get here, only explode once.
+	if (!IsInFlight) {
+		return;
+	}
+
+	PlaySound(ExplosionSound, ToonTanksSoundPriority::Explosion);
+	SpawnEffect(ExplosionParticle);
+
+	// Physics objects get their movement replicated from the server, so only push them there.
+	if (!IsCosmetic()) {
+		CreateExplosionImpulse(GetActorLocation());
+	}
 
-	CreateExplosionImpulse(GetActorLocation());
+	ReturnToPool();
+}
 
-	Destroy();
+/// Give this projectile back to the pool (or just destroy it if this world has no pool).
+void AProjectileBase::ReturnToPool()
+{
+	UProjectilePoolSubsystem* ProjectilePool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+	if (ProjectilePool) {
+		ProjectilePool->ReleaseProjectile(this);
+	}
+	else {
+		if (USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>()) {
+			Significance->UnregisterProjectile(this);
+		}
+		StopSimulationSteps();
+		Destroy();
+	}
 }
 
-/// Check for actors in radius of explosion and apply impulse. \n\n
+/// One fixed simulation step: move (which can hit something and send us back to the pool),
+/// then count down the fuse and lifespan, same as their timers would.
+void AProjectileBase::SimulationStep(float StepSeconds)
+{
+	ProjectileMovement->TickComponent(StepSeconds, LEVELTICK_All, nullptr);
+	if (!IsInFlight) {
+		return;
+	}
+
+	if (FuseTimeLeft >= 0) {
+		FuseTimeLeft -= StepSeconds;
+		if (FuseTimeLeft <= 0) {
+			DestroyProjectile();
+			return;
+		}
+	}
+	if (LifeSpanLeft >= 0) {
+		LifeSpanLeft -= StepSeconds;
+		if (LifeSpanLeft <= 0) {
+			ReturnToPool();
+		}
+	}
+}
+
+/// Back to per-frame movement, for whenever we next launch.
+void AProjectileBase::StopSimulationSteps()
+{
+	if (!SimulationClock) {
+		return;
+	}
+	SimulationClock->OnStep.Remove(SimulationStepHandle);
+	SimulationStepHandle.Reset();
+	SimulationClock = nullptr;
+	FuseTimeLeft = -1;
+	LifeSpanLeft = -1;
+}
+
+/// Same idea as APawnBase::SetSignificanceTier(), but only cosmetic projectiles move in bigger steps.
+/// On the server a bigger step changes where a bounce lands, and that's where the damage and explosion happen,
+/// so there far projectiles only get the lower LOD.
+void AProjectileBase::SetSignificanceTier(ESignificanceTier Tier)
+{
+	ProjectileMovement->SetComponentTickInterval(IsCosmetic() ? USignificanceSubsystem::GetTickInterval(Tier) : 0);
+	ProjectileMesh->SetForcedLodModel(USignificanceSubsystem::GetForcedLod(Tier));
+}
+
+/// Grenades that bounce off the edge of the map go back to the pool instead of being destroyed.
+void AProjectileBase::FellOutOfWorld(const UDamageType& DmgType)
+{
+	if (IsInFlight) {
+		ReturnToPool();
+	}
+}
+
+/// Queue a radial impulse for actors in radius of the explosion. \n\n
 /// https://youtu.be/qDcUTDfkZes
 void AProjectileBase::CreateExplosionImpulse(FVector Location)
 {
-	// Create basic collision shape!
-	FCollisionShape Spherical = FCollisionShape::MakeSphere(ImpulseRadius);
-
-	// Do a sweep check in a radius with SweepMultiChannel().
-	bool SweepHit = GetWorld()->SweepMultiByChannel(
-		OUT HitResults,						// Our array of results.
-		GetActorLocation(),					// Start location.
-		GetActorLocation() * 1.01f,			// End location (has to be different than start).
-		FQuat::Identity,                    // Rotation (none needed, so blank FQuat).
-		ECC_WorldStatic,					// Collision channel.
-		Spherical							// Shape.
-		);
+	TOONTANKS_SCOPE_CYCLE(ExplosionImpulse);
 
-	if (SweepHit) {
-		for (auto& Hit: HitResults) {
-			// First, see if the hit actor has a mesh component.
-			UStaticMeshComponent* Mesh = Cast<UStaticMeshComponent>(Hit.GetActor()->GetRootComponent());
-			// If there is, we'll apply the radial impulse to it.
-			if (Mesh) {
-				// Grab the mass so we can use more reasonable force numbers.
-				float Mass = Mesh->GetMass();
-
-				Mesh->AddRadialImpulse(
-					GetActorLocation(),	 // Impulse Location.
-					ImpulseRadius,	     // Radius.
-					ImpulseForce * Mass, // Force.
-					RIF_Constant,	     // RIF (Radial Impact Force) falloff type.
-					false);
-			}
-		}
+	// The ExplosionSubsystem handles every explosion of this frame together at the end of the frame,
+	// so a volley of grenades going off at once shares overlap checks, and each body gets pushed once.
+	// ImpulseForce is applied per unit of mass there (same as multiplying by GetMass() like we used to).
+	// Splash damage is resolved there too, with every grenade's damage to a pawn added up into one hit.
+	if (UExplosionSubsystem* Explosions = GetWorld()->GetSubsystem<UExplosionSubsystem>()) {
+		Explosions->QueueWeaponExplosion(Location, GetWeapon(), GetOwner());
 	}
 }
@@ -63,6 +63,10 @@
 // Forward declarations.
 class UProjectileMovementComponent;
 class ATriggerSphere;
+class USimulationClockSubsystem;
+struct FWeaponDefinition;
+enum class ESignificanceTier : uint8;
+enum class EPawnTags : uint8;
 
 // -------------------------------------------------------------------------------------------
 UCLASS()
@@ -70,10 +74,33 @@ class TOONTANKS_API AProjectileBase : public AActor
 {
 	GENERATED_BODY()
 
+	/// Reads our effects, mesh and movement settings off the class default object.
+	friend class UProjectileSimulationSubsystem;
+	friend class USignificanceSubsystem;
+
 public:
 	// Sets default values for this actor's properties
 	AProjectileBase();
 
+	/// Called by the projectile pool to launch this projectile from Location, towards Rotation.
+	void ActivateFromPool(const FVector& Location, const FRotator& Rotation, AActor* NewOwner);
+	/// Called by the projectile pool to hide and stop this projectile until it's needed again.
+	void DeactivateToPool();
+	int32 GetPoolSize() const { return PoolSize; }
+	/// True from ActivateFromPool() until we're back in the pool.
+	bool IsLaunched() const { return IsInFlight; }
+	bool UsesLightweightSimulation() const { return UseLightweightSimulation; }
+	/// On the class default object, this is what the UBallisticsSubsystem reads launch speed and gravity from.
+	const UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+	FName GetWeaponName() const { return WeaponName; }
+	/// The weapon made from our class default object's fallback properties, for when WeaponName isn't in the weapon table.
+	FWeaponDefinition GetFallbackWeapon() const;
+	/// Our weapon's tuning, fresh from the weapon table.
+	const FWeaponDefinition& GetWeapon() const;
+	virtual void FellOutOfWorld(const UDamageType& DmgType) override;
+	/// Called by the USignificanceSubsystem while we're in flight: far away projectiles use a lower LOD, and on clients move in bigger steps.
+	void SetSignificanceTier(ESignificanceTier Tier);
+
 private:
 	// See notes above about UFUNCTIONS and Delegates for working with Events.
 	/// Will be a Dynamic Delegate. Used to handle our OnComponentHit info for damage, destruction, etc. \n
@@ -87,7 +114,14 @@ private:
 		const FHitResult& Hit
 		);
 
-	void PlaySoundNoSpam(USoundBase* SoundToPlay);
+	void PlaySound(USoundBase* SoundToPlay, float Priority);
+	/// PlaySound() for our impact sounds, at most once per ToonTanks.Projectiles.ImpactSoundCooldown.
+	void PlayImpactSound(USoundBase* SoundToPlay, float Priority);
+	/// Seconds between impact sounds from one projectile (the UProjectileSimulationSubsystem uses it too).
+	static float GetImpactSoundCooldown();
+	/// Hits on the same non-pawn component closer together than this are the same bounce (the simulation uses it too).
+	static float GetRepeatedHitWindow();
+	void SpawnEffect(UParticleSystem* Effect);
 
 	// -----------------------------------------------------------------------
 	UPROPERTY(EditAnywhere, Category="Effects")
@@ -102,7 +136,7 @@ private:
 	USoundBase* LaunchSound;
 	UPROPERTY(EditAnywhere, Category="Effects")
 	USoundBase* ExplosionSound;
-	float WorldTime;
+	/// When our last impact sound played, so rolling along the ground doesn't spam it.
 	float TimeHitSoundPlayed = 0;
 
 	// UMatineeCameraShake is a legacy Camera Shake. The new one is CameraShakeBase.
@@ -128,46 +162,92 @@ private:
 	UStaticMeshComponent* ProjectileMesh;
 
 	// -----------------------------------------------------------------------
+	/// Which row of the weapon table our damage, speed, lifetime and explosion come from
+	/// (see UWeaponDefinitionSubsystem). None, or a name that isn't in the table, uses the fallback properties below.
+	UPROPERTY(EditDefaultsOnly, Category="Weapon")
+	FName WeaponName;
+	/// WeaponName's id, looked up on our first launch. Everything in flight reads the weapon through this.
+	int32 WeaponId = INDEX_NONE;
+
+	// -----------------------------------------------------------------------
+	// The tuning from before the weapon table, kept so Blueprints that set it still load it. Every projectile
+	// has these (a class default object is just another instance), but only the class default object's
+	// are ever read, once, to seed the weapon when WeaponName has no row in the table. Flying never reads them.
 	UPROPERTY(
-		EditAnywhere,
+		EditDefaultsOnly,
 		BlueprintReadOnly,
-		Category="Movement",
+		Category="Weapon (fallback)",
 		meta=(AllowPrivateAccess = "true"))
 	float MoveSpeedStart = 500;
 
 	UPROPERTY(
-		EditAnywhere,
+		EditDefaultsOnly,
 		BlueprintReadOnly,
-		Category="Movement",
+		Category="Weapon (fallback)",
 		meta=(AllowPrivateAccess = "true"))
 	float MoveSpeedMax = 3000;
 
-	// -----------------------------------------------------------------------
 	UPROPERTY(
-		EditAnywhere,
+		EditDefaultsOnly,
 		BlueprintReadOnly,
-		Category="Life",
+		Category="Weapon (fallback)",
 		meta=(AllowPrivateAccess = "true"))
 	float LifeSpan = 5;
-	float ExplosionTimer = LifeSpan / 2;
-
-	// -----------------------------------------------------------------------
-	// See notes up top about TSubclassOf.
-	UPROPERTY(EditDefaultsOnly, Category="Damage")
-	TSubclassOf<UDamageType> DamageType;
 
 	UPROPERTY(
-		EditAnywhere,
+		EditDefaultsOnly,
 		BlueprintReadOnly,
-		Category="Damage",
+		Category="Weapon (fallback)",
 		meta=(AllowPrivateAccess = "true"))
 	float Damage = 50;
 
+	// Radial Impulse.
+	UPROPERTY(EditDefaultsOnly, Category="Weapon (fallback)")
+	float ImpulseRadius = 500;
+	UPROPERTY(EditDefaultsOnly, Category="Weapon (fallback)")
+	float ImpulseForce = 2000;
+
+	/// How many of this projectile class to spawn up front in the projectile pool.
+	UPROPERTY(EditDefaultsOnly, Category="Life")
+	int32 PoolSize = 16;
+	/// Fly this class as a plain struct in the UProjectileSimulationSubsystem instead of as a pooled actor.
+	/// Much cheaper when there are hundreds in the air, but OnHit() and any Blueprint logic never run.
+	UPROPERTY(EditDefaultsOnly, Category="Simulation")
+	bool UseLightweightSimulation = false;
+	/// Our slot in the USignificanceSubsystem arrays, only while we're in flight.
+	int32 SignificanceIndex = INDEX_NONE;
+	/// False while sitting in the pool, so we don't explode or recycle twice.
+	bool IsInFlight = false;
+	/// On clients projectiles are look-alikes of the server's: same flight, sounds and effects, but no damage.
+	bool IsCosmetic() const { return GetNetMode() == NM_Client; }
+
+	// -----------------------------------------------------------------------
+	// See notes up top about TSubclassOf.
+	UPROPERTY(EditDefaultsOnly, Category="Damage")
+	TSubclassOf<UDamageType> DamageType;
+
 	// -----------------------------------------------------------------------
 	UPROPERTY()
 	FTimerHandle ExplosionTimerHandle;
-	bool IsTurret = false;
-	bool IsTank = false;
+	/// Replaces InitialLifeSpan, since pooled projectiles go back to the pool instead of being destroyed.
+	FTimerHandle LifeSpanTimerHandle;
+
+	/// Only set while we're in flight in a World on a fixed timestep (see USimulationClockSubsystem).
+	/// Then ProjectileMovement moves in SimulationStep(), and the two timers above are counted down there instead.
+	UPROPERTY()
+	USimulationClockSubsystem* SimulationClock;
+	FDelegateHandle SimulationStepHandle;
+	/// Seconds left on the fuse and lifespan, on a fixed timestep. Negative when not counting.
+	float FuseTimeLeft = -1;
+	float LifeSpanLeft = -1;
+	void SimulationStep(float StepSeconds);
+	void StopSimulationSteps();
+	/// The component we last hit, and the tags of its pawn (see APawnBase::GetTagsOf()). Rolling along
+	/// the floor hits it every frame, so we only classify a component on the first hit in a row.
+	TWeakObjectPtr<UPrimitiveComponent> LastHitComponent;
+	/// Value-initialized, which is EPawnTags::None (the enum is only forward declared here).
+	EPawnTags LastHitTags{};
+	float LastHitTime = 0;
 	UPROPERTY(EditAnywhere)
 	bool EnableDebugView;
 
@@ -175,14 +255,7 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 	void DestroyProjectile();
+	void ReturnToPool();
 	void CreateExplosionImpulse(FVector Location);
 
-	// Radial Impulse.
-	UPROPERTY(EditAnywhere)
-	float ImpulseRadius = 500;
-	UPROPERTY(EditAnywhere)
-	float ImpulseForce = 2000;
-	UPROPERTY()
-	TArray<FHitResult> HitResults;
-
 };
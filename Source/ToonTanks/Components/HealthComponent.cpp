@@ -4,6 +4,9 @@
 #include "HealthComponent.h"
 #include "ToonTanks/GameModes/TankGameModeBase.h"
 #include "Kismet/GameplayStatics.h"
+#include "ToonTanks/Pawns/PawnBase.h"
+#include "ToonTanks/Subsystems/CombatLogSubsystem.h"
+#include "ToonTanks/Subsystems/DamageSubsystem.h"
 
 // -------------------------------------------------------------------------------------------
 /// Sets default values for this component's properties.
@@ -21,31 +24,93 @@ void UHealthComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	Health = DefaultHealth;
+	// Thresholds in health points, highest first, so FindNextThreshold() can stop at the first one below.
+	ThresholdHealths.Reset(HealthThresholds.Num());
+	for (const float Fraction : HealthThresholds) {
+		if (Fraction > 0 && Fraction < 1) {
+			ThresholdHealths.Add(Fraction * DefaultHealth);
+		}
+	}
+	ThresholdHealths.Sort(TGreater<float>());
+
 	// A reference to our world's current active game mode, cast as GameModeBase class.
 	GameModeRef = Cast<ATankGameModeBase>(UGameplayStatics::GetGameMode(GetWorld()));
-	// Bind "OnTakeAnyDamage" event to our TakeDamage function.
-	GetOwner()->OnTakeAnyDamage.AddDynamic(this, &UHealthComponent::TakeDamage);
+	// Our health lives in the DamageSubsystem, next to everyone else's.
+	DamageSubsystem = GetWorld()->GetSubsystem<UDamageSubsystem>();
+	if (DamageSubsystem) {
+		DamageSubsystem->RegisterHealth(this, DefaultHealth);
+	}
+	// Our pawns override TakeDamage() and come straight to the DamageSubsystem.
+	// Anything else only has the "OnTakeAnyDamage" event, so bind our TakeDamage function to it.
+	if (!GetOwner()->IsA<APawnBase>()) {
+		GetOwner()->OnTakeAnyDamage.AddDynamic(this, &UHealthComponent::TakeDamage);
+	}
 	// ...
 
 }
 
+// -------------------------------------------------------------------------------------------
+void UHealthComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (DamageSubsystem) {
+		DamageSubsystem->UnregisterHealth(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 // -------------------------------------------------------------------------------------------
 /// Handle taking damage. Receive healing if negative damage is taken.
 void UHealthComponent::TakeDamage(AActor* DamagedActor, float Damage, const UDamageType* DamageType,
 	AController* Instigator, AActor* DamageCauser)
 {
-	// If 0 damage was taken, or if target is already dead, we don't need to do anything below.
-	if(Damage == 0 || Health <= 0) {
-		return;
+	ApplyDamage(Damage, GetDamageInstigator(Instigator, DamageCauser));
+}
+
+// -------------------------------------------------------------------------------------------
+void UHealthComponent::ApplyDamage(float Damage, const AActor* DamageInstigator)
+{
+	if (DamageSubsystem) {
+		DamageSubsystem->ApplyDamage(HealthHandle, Damage, DamageInstigator);
 	}
+}
 
-	// Clamp here ensures we can't have negative health, or more health than DefaultHealth.
-	Health = FMath::Clamp(Health - Damage, 0.f, DefaultHealth);
-	UE_LOG(LogTemp, Warning, TEXT("%s Health: %f"), *GetOwner()->GetName(), Health);
+// -------------------------------------------------------------------------------------------
+const AActor* UHealthComponent::GetDamageInstigator(AController* Instigator, AActor* DamageCauser)
+{
+	const AActor* DamageInstigator = Instigator && Instigator->GetPawn() ? Instigator->GetPawn() : nullptr;
+	if (!DamageInstigator && DamageCauser) {
+		DamageInstigator = DamageCauser->GetOwner() ? DamageCauser->GetOwner() : DamageCauser;
+	}
+	return DamageInstigator;
+}
+
+// -------------------------------------------------------------------------------------------
+float UHealthComponent::FindNextThreshold(float Health) const
+{
+	for (const float Threshold : ThresholdHealths) {
+		if (Threshold < Health) {
+			return Threshold;
+		}
+	}
+	return 0;
+}
+
+// -------------------------------------------------------------------------------------------
+/// The health itself has already changed, and the hit's been logged and scored. This is just the events.
+void UHealthComponent::HandleHealthChange(float PreviousHealth, float Health, const AActor* DamageInstigator)
+{
+	for (const float Threshold : ThresholdHealths) {
+		if (Threshold < PreviousHealth && Threshold >= Health) {
+			OnHealthThresholdCrossed.Broadcast(Threshold / DefaultHealth);
+		}
+	}
 
 	// Death condition.
 	if (Health <= 0) {
+		if (UCombatLogSubsystem* CombatLog = GetWorld()->GetSubsystem<UCombatLogSubsystem>()) {
+			CombatLog->LogDeath(GetOwner(), DamageInstigator);
+		}
+		OnDied.Broadcast(const_cast<AActor*>(DamageInstigator));
 		if (!GameModeRef) {
 			UE_LOG(LogTemp, Error, TEXT("HealthComponent has no reference to GameMode!"))
 			UE_LOG(LogTemp, Error, TEXT("Unable to report death of actor %s to GameMode."), *GetOwner()->GetName());
@@ -57,7 +122,7 @@ void UHealthComponent::TakeDamage(AActor* DamagedActor, float Damage, const UDam
 	// ...
 }
 
-float UHealthComponent::GetHealth()
+float UHealthComponent::GetHealth() const
 {
-	return Health;
+	return DamageSubsystem ? DamageSubsystem->GetHealth(HealthHandle) : 0;
 }
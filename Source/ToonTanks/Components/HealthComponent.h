@@ -10,6 +10,10 @@
 
 // Forward declarations.
 class ATankGameModeBase;
+class UDamageSubsystem;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FHealthThresholdCrossedSignature, float, Threshold);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FDiedSignature, AActor*, Killer);
 
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
@@ -21,20 +25,49 @@ public:
 	// Sets default values for this component's properties
 	UHealthComponent();
 	UFUNCTION(BlueprintCallable)
-	float GetHealth();
+	float GetHealth() const;
+	/// Our slot in the UDamageSubsystem (INDEX_NONE before BeginPlay and after EndPlay).
+	int32 GetHealthHandle() const { return HealthHandle; }
+	/// Lose Damage health through the UDamageSubsystem, same as any other hit. Negative Damage heals.
+	void ApplyDamage(float Damage, const AActor* DamageInstigator);
+	/// Whoever's behind some engine damage: the pawn the instigating controller drives, or the owner of the projectile.
+	static const AActor* GetDamageInstigator(AController* Instigator, AActor* DamageCauser);
+
+	/// Fires once each time health drops to (or past) one of our HealthThresholds. Not on every hit.
+	UPROPERTY(BlueprintAssignable)
+	FHealthThresholdCrossedSignature OnHealthThresholdCrossed;
+	/// Fires once, when health hits 0.
+	UPROPERTY(BlueprintAssignable)
+	FDiedSignature OnDied;
 
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 	UPROPERTY(EditAnywhere)
 	float DefaultHealth = 9;
-	float Health = 0;
+	/// Fractions of DefaultHealth (0.5 is half health) that fire OnHealthThresholdCrossed on the way down.
+	UPROPERTY(EditAnywhere)
+	TArray<float> HealthThresholds;
+	/// HealthThresholds in health points, highest first.
+	TArray<float> ThresholdHealths;
 
 	UPROPERTY()
 	ATankGameModeBase* GameModeRef;
+	UPROPERTY()
+	UDamageSubsystem* DamageSubsystem;
+
+	/// Set and fixed up by the UDamageSubsystem, which holds our actual health.
+	int32 HealthHandle = INDEX_NONE;
+	friend class UDamageSubsystem;
+	/// The health the UDamageSubsystem next needs to tell us about, from Health: our next threshold down, or 0.
+	float FindNextThreshold(float Health) const;
+	/// Called by the UDamageSubsystem only when a hit crossed a threshold, killed us, or healed us.
+	void HandleHealthChange(float PreviousHealth, float Health, const AActor* DamageInstigator);
 
+	/// Only bound for owners that don't route TakeDamage() to us themselves (see APawnBase::TakeDamage()).
 	UFUNCTION()
 	void TakeDamage(
 		AActor* DamagedActor,
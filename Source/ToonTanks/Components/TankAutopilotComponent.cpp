@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TankAutopilotComponent.h"
+
+#include "ToonTanks/Pawns/PawnTank.h"
+#include "ToonTanks/Pawns/PawnTurret.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/Subsystems/TurretManagerSubsystem.h"
+
+// -------------------------------------------------------------------------------------------
+/// Sets default values for this component's properties.
+UTankAutopilotComponent::UTankAutopilotComponent()
+{
+	// Tick before physics, same as the player's input would.
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called when the game starts.
+void UTankAutopilotComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Tank = Cast<APawnTank>(GetOwner());
+	if (!Tank) {
+		return;
+	}
+	Tank->SetAutopilot(true);
+
+	// On a fixed timestep the tank can take several steps in one frame, so decide once per step instead of per frame.
+	const USimulationClockSubsystem* SimulationClock = GetWorld()->GetSubsystem<USimulationClockSubsystem>();
+	if (SimulationClock && SimulationClock->IsFixedStep()) {
+		StepHandle = Tank->OnAutopilotStep.AddUObject(this, &UTankAutopilotComponent::Steer);
+		SetComponentTickEnabled(false);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UTankAutopilotComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Tank) {
+		Tank->OnAutopilotStep.Remove(StepHandle);
+		Tank->SetAutopilot(false);
+	}
+	StepHandle.Reset();
+	Super::EndPlay(EndPlayReason);
+}
+
+// -------------------------------------------------------------------------------------------
+void UTankAutopilotComponent::TickComponent(float DeltaTime, ELevelTick TickType,
+	FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	Steer();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Pick the closest turret, turn towards it, drive until we're in FireRange, then shoot.
+/// Not while the tank's input is off (the countdown, game over), same as a player.
+void UTankAutopilotComponent::Steer()
+{
+	if (!Tank || !Tank->IsPlayerAlive() || !Tank->IsInputEnabled()) {
+		return;
+	}
+
+	APawnTurret* Target = FindClosestTurret();
+	if (!Target) {
+		Tank->SetAutopilotInput(0, 0, false);
+		return;
+	}
+
+	const FVector TargetLocation = Target->GetActorLocation();
+	const FVector ToTarget = TargetLocation - Tank->GetActorLocation();
+
+	// How far we'd need to turn to face the target, from -180 to 180.
+	const float TargetYaw = ToTarget.Rotation().Yaw;
+	const float YawError = FRotator::NormalizeAxis(TargetYaw - Tank->GetActorRotation().Yaw);
+	const float Turn = FMath::Clamp(YawError / FullTurnAngle, -1.f, 1.f);
+
+	// Drive while we're out of range, slowing down when we're facing the wrong way.
+	const bool InRange = ToTarget.SizeSquared2D() <= FMath::Square(FireRange);
+	const float Move = InRange ? 0 : 1 - FMath::Abs(Turn);
+
+	Tank->AimAt(TargetLocation);
+	Tank->SetAutopilotInput(Move, Turn, InRange);
+}
+
+// -------------------------------------------------------------------------------------------
+APawnTurret* UTankAutopilotComponent::FindClosestTurret() const
+{
+	UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>();
+	if (!TurretManager) {
+		return nullptr;
+	}
+
+	const FVector TankLocation = Tank->GetActorLocation();
+	APawnTurret* Closest = nullptr;
+	float ClosestDistanceSquared = TNumericLimits<float>::Max();
+
+	for (APawnTurret* Turret : TurretManager->GetTurrets()) {
+		const float DistanceSquared = FVector::DistSquared(Turret->GetActorLocation(), TankLocation);
+		if (DistanceSquared < ClosestDistanceSquared) {
+			ClosestDistanceSquared = DistanceSquared;
+			Closest = Turret;
+		}
+	}
+	return Closest;
+}
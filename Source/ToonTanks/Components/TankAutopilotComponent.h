@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+
+#include "TankAutopilotComponent.generated.h"
+
+// Forward declarations.
+class APawnTank;
+class APawnTurret;
+
+
+/**
+ * A very simple scripted driver for the tank: drive at the closest turret, stop at FireRange,
+ * aim and keep shooting until it's dead, then move on to the next one. \n
+ * Used by the balancing runner so matches can play out with nobody at the controls.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class TOONTANKS_API UTankAutopilotComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UTankAutopilotComponent();
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/// Decide this frame's (or fixed step's) input, and hand it to the tank.
+	void Steer();
+	APawnTurret* FindClosestTurret() const;
+
+	/// How close we drive up to a turret before stopping to shoot it.
+	UPROPERTY(EditAnywhere, Category="Autopilot")
+	float FireRange = 1500;
+	/// Degrees off from facing the target that counts as full turn input.
+	UPROPERTY(EditAnywhere, Category="Autopilot")
+	float FullTurnAngle = 30;
+
+	UPROPERTY()
+	APawnTank* Tank;
+	/// Set on a fixed timestep, where we Steer() from the tank's OnAutopilotStep instead of ticking.
+	FDelegateHandle StepHandle;
+};
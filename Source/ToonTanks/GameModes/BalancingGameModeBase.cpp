@@ -0,0 +1,192 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BalancingGameModeBase.h"
+
+#include "HAL/FileManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ToonTanks/Components/TankAutopilotComponent.h"
+#include "ToonTanks/Pawns/PawnTank.h"
+#include "ToonTanks/Pawns/PawnTurret.h"
+#include "ToonTanks/PlayerControllers/PlayerControllerBase.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/Subsystems/TurretManagerSubsystem.h"
+
+// -------------------------------------------------------------------------------------------
+ABalancingGameModeBase::ABalancingGameModeBase()
+{
+	DefaultPawnClass = APawnTank::StaticClass();
+	PlayerControllerClass = APlayerControllerBase::StaticClass();
+	TankClass = APawnTank::StaticClass();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Read the run settings off the command line, and which match this is off the URL.
+void ABalancingGameModeBase::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FParse::Value(CommandLine, TEXT("BalanceMatches="), NumMatches);
+	FParse::Value(CommandLine, TEXT("BalanceMaxMatchSeconds="), MaxMatchSeconds);
+	FParse::Value(CommandLine, TEXT("BalanceTimeDilation="), TimeDilation);
+	FParse::Value(CommandLine, TEXT("BalanceTag="), Tag);
+	if (!FParse::Value(CommandLine, TEXT("BalanceOut="), OutFileName)) {
+		OutFileName = FString::Printf(TEXT("Balance-%s.csv"), *Tag);
+	}
+
+	// The plain C++ tank has no meshes or projectile set, so we normally want the Blueprint one here.
+	FString ClassPath;
+	if (FParse::Value(CommandLine, TEXT("BalanceTankClass="), ClassPath)) {
+		if (UClass* LoadedClass = LoadClass<APawnTank>(nullptr, *ClassPath)) {
+			TankClass = LoadedClass;
+		}
+	}
+	DefaultPawnClass = TankClass;
+
+	MatchNumber = UGameplayStatics::GetIntOption(Options, TEXT("BalanceMatch"), 1);
+}
+
+// -------------------------------------------------------------------------------------------
+/// The base class finds the player tank, then we hand it over to the autopilot and start the clock.
+void ABalancingGameModeBase::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UGameplayStatics::SetGlobalTimeDilation(this, TimeDilation);
+
+	if (APawnTank* Tank = GetPlayerTank()) {
+		UTankAutopilotComponent* Autopilot = NewObject<UTankAutopilotComponent>(Tank);
+		Autopilot->RegisterComponent();
+	}
+
+	UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>();
+	TurretsAtStart = TurretManager ? TurretManager->GetNumTurrets() : 0;
+	MatchStartTime = GetMatchSeconds();
+
+	// Timers run on dilated time, so this is MaxMatchSeconds of game time. With a fixed step we check
+	// the simulated time instead, since that can run ahead of World time.
+	GetWorldTimerManager().SetTimer(TimeoutTimerHandle, this, &ABalancingGameModeBase::MatchTimedOut, 1, true);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Anything the player tank loses came from a turret, and anything a turret loses came from the player.
+void ABalancingGameModeBase::ActorDamaged(AActor* DamagedActor, float HealthLost)
+{
+	if (IsMatchOver || HealthLost <= 0) {
+		return;
+	}
+
+	if (DamagedActor == GetPlayerTank()) {
+		TurretHits++;
+		TurretDamageDealt += HealthLost;
+	}
+	else if (Cast<APawnTurret>(DamagedActor)) {
+		PlayerHits++;
+		PlayerDamageDealt += HealthLost;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void ABalancingGameModeBase::PawnFired(APawnBase* Shooter)
+{
+	if (IsMatchOver) {
+		return;
+	}
+
+	if (Shooter == GetPlayerTank()) {
+		PlayerShots++;
+	}
+	else {
+		TurretShots++;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void ABalancingGameModeBase::HandleGameOver(bool PlayerWon)
+{
+	if (IsMatchOver) {
+		return;
+	}
+	IsMatchOver = true;
+	GetWorldTimerManager().ClearTimer(TimeoutTimerHandle);
+
+	Super::HandleGameOver(PlayerWon);
+	AppendSummary(IsTimedOut ? TEXT("Timeout") : PlayerWon ? TEXT("Win") : TEXT("Loss"));
+
+	// We're somewhere inside a damage callback here, so leave the World alone until the next tick.
+	GetWorldTimerManager().SetTimerForNextTick(this, &ABalancingGameModeBase::NextMatch);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Game seconds since the World started: simulated time with a fixed step, dilated World time otherwise.
+float ABalancingGameModeBase::GetMatchSeconds() const
+{
+	USimulationClockSubsystem* SimulationClock = GetWorld()->GetSubsystem<USimulationClockSubsystem>();
+	if (SimulationClock && SimulationClock->IsFixedStep()) {
+		return SimulationClock->GetSimulatedTime();
+	}
+	return GetWorld()->GetTimeSeconds();
+}
+
+// -------------------------------------------------------------------------------------------
+void ABalancingGameModeBase::MatchTimedOut()
+{
+	if (GetMatchSeconds() - MatchStartTime < MaxMatchSeconds) {
+		return;
+	}
+	IsTimedOut = true;
+	HandleGameOver(false);
+}
+
+// -------------------------------------------------------------------------------------------
+/// One line per match, appended to the same file for the whole run. The header goes in with the first line.
+void ABalancingGameModeBase::AppendSummary(const TCHAR* Result) const
+{
+	const FString FilePath = FPaths::Combine(FPaths::ProfilingDir(), TEXT("Balancing"), OutFileName);
+
+	UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>();
+	const int32 TurretsAlive = TurretManager ? TurretManager->GetNumTurrets() : 0;
+
+	FString Line;
+	if (!IFileManager::Get().FileExists(*FilePath)) {
+		Line = TEXT("Tag,Match,Result,Seconds,TurretsAtStart,TurretsAlive,")
+			TEXT("PlayerShots,PlayerHits,PlayerDamage,TurretShots,TurretHits,TurretDamage\n");
+	}
+	Line += FString::Printf(TEXT("%s,%d,%s,%.2f,%d,%d,%d,%d,%.1f,%d,%d,%.1f\n"),
+		*Tag, MatchNumber, Result, GetMatchSeconds() - MatchStartTime, TurretsAtStart, TurretsAlive,
+		PlayerShots, PlayerHits, PlayerDamageDealt, TurretShots, TurretHits, TurretDamageDealt);
+
+	if (!FFileHelper::SaveStringToFile(Line, *FilePath, FFileHelper::EEncodingOptions::AutoDetect,
+		&IFileManager::Get(), FILEWRITE_Append)) {
+		UE_LOG(LogTemp, Error, TEXT("Unable to write balancing results to %s"), *FilePath);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Balancing: match %d/%d %s after %.1fs."),
+		MatchNumber, NumMatches, Result, GetMatchSeconds() - MatchStartTime);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Reload the map with the same options and the next match number, or quit if we're done.
+void ABalancingGameModeBase::NextMatch()
+{
+	if (MatchNumber >= NumMatches) {
+		UE_LOG(LogTemp, Display, TEXT("Balancing done: %d matches written to %s."), NumMatches, *OutFileName);
+		FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	// Keep ?game= and anything else we were started with, so the next match runs the same way.
+	const FURL& CurrentURL = GetWorld()->URL;
+	FString TravelURL = CurrentURL.Map;
+	for (const FString& Option : CurrentURL.Op) {
+		if (!Option.StartsWith(TEXT("BalanceMatch="))) {
+			TravelURL += TEXT("?") + Option;
+		}
+	}
+	TravelURL += FString::Printf(TEXT("?BalanceMatch=%d"), MatchNumber + 1);
+
+	GetWorld()->ServerTravel(TravelURL, true);
+}
@@ -0,0 +1,88 @@
+// -------------------------------------------------------------------------------------------
+/* Headless balancing runner, for trying out FireRate/ThreatRange/Damage/DefaultHealth changes
+ * without playing the same match fifty times by hand.
+ *
+ * Example (from the project folder):
+ *   UE4Editor ToonTanks.uproject /Game/Maps/Main?game=/Script/ToonTanks.BalancingGameModeBase
+ *       -game -nullrhi -nosound -unattended -FixedStepHz=60 -ExecCmds="ToonTanks.Sim.StepsPerFrame 20"
+ *       -BalanceMatches=200 -BalanceTag=FireRate2 -BalanceMaxMatchSeconds=300
+ *       -BalanceTankClass=/Game/Path/To/BP_PawnTank.BP_PawnTank_C
+ *
+ * The player tank is driven by a UTankAutopilotComponent. Every match appends one line to
+ * Saved/Profiling/Balancing/<BalanceOut or Balance-Tag>.csv, then the map is reloaded for the next match.
+ * StepsPerFrame is what makes it fast: each frame simulates that many fixed steps, so with nothing
+ * to render a match takes a fraction of a second. -BalanceTimeDilation= does the same thing for
+ * runs without a fixed step, but it's capped by the World Settings' MaxGlobalTimeDilation.
+ * To sweep a parameter, run once per value (Blueprint defaults or ini) with a different -BalanceTag.
+*/
+// -------------------------------------------------------------------------------------------
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TankGameModeBase.h"
+
+#include "BalancingGameModeBase.generated.h"
+
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Plays back to back matches with an autopilot tank and writes a one line summary per match:
+ * result, match length, shots, hits and damage for each side. See notes at top for how to run it.
+ */
+UCLASS()
+class TOONTANKS_API ABalancingGameModeBase : public ATankGameModeBase
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	ABalancingGameModeBase();
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void ActorDamaged(AActor* DamagedActor, float HealthLost) override;
+	virtual void PawnFired(APawnBase* Shooter) override;
+
+protected:
+	// ---------------------------------------------------------
+	virtual void BeginPlay() override;
+	virtual void HandleGameOver(bool PlayerWon) override;
+
+	UPROPERTY(EditDefaultsOnly, Category="Balancing")
+	TSubclassOf<APawnTank> TankClass;
+
+	/// Matches to play before quitting (-BalanceMatches=).
+	UPROPERTY(EditDefaultsOnly, Category="Balancing")
+	int32 NumMatches = 100;
+	/// Matches that run longer than this (in game seconds) end as a timeout (-BalanceMaxMatchSeconds=).
+	UPROPERTY(EditDefaultsOnly, Category="Balancing")
+	float MaxMatchSeconds = 300;
+	/// Global time dilation for the match (-BalanceTimeDilation=).
+	UPROPERTY(EditDefaultsOnly, Category="Balancing")
+	float TimeDilation = 1;
+
+private:
+	// ---------------------------------------------------------
+	float GetMatchSeconds() const;
+	void MatchTimedOut();
+	void AppendSummary(const TCHAR* Result) const;
+	void NextMatch();
+
+	/// Label written in every row, so several sweep runs can go in one file (-BalanceTag=).
+	FString Tag = TEXT("Default");
+	/// CSV file name inside Saved/Profiling/Balancing (-BalanceOut=).
+	FString OutFileName;
+	/// 1-based, carried from match to match in the travel URL.
+	int32 MatchNumber = 1;
+
+	double MatchStartTime = 0;
+	int32 TurretsAtStart = 0;
+	int32 PlayerShots = 0;
+	int32 PlayerHits = 0;
+	float PlayerDamageDealt = 0;
+	int32 TurretShots = 0;
+	int32 TurretHits = 0;
+	float TurretDamageDealt = 0;
+	bool IsMatchOver = false;
+	bool IsTimedOut = false;
+
+	FTimerHandle TimeoutTimerHandle;
+};
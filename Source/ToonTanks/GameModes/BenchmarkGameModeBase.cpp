@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BenchmarkGameModeBase.h"
+
+#include "HAL/PlatformMemory.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderCore.h"
+#include "ToonTanks/Pawns/PawnTank.h"
+#include "ToonTanks/Pawns/PawnTurret.h"
+#include "ToonTanks/PlayerControllers/PlayerControllerBase.h"
+#include "ToonTanks/Subsystems/ProjectilePoolSubsystem.h"
+#include "ToonTanks/Subsystems/TurretManagerSubsystem.h"
+
+// -------------------------------------------------------------------------------------------
+void FBenchmarkPostPhysicsTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType,
+	ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target && !Target->IsPendingKill()) {
+		Target->PostPhysicsTick();
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+FString FBenchmarkPostPhysicsTickFunction::DiagnosticMessage()
+{
+	return TEXT("FBenchmarkPostPhysicsTickFunction");
+}
+
+// -------------------------------------------------------------------------------------------
+ABenchmarkGameModeBase::ABenchmarkGameModeBase()
+{
+	// We tick before physics to start the physics timer, and PostPhysicsTickFunction stops it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	DefaultPawnClass = APawnTank::StaticClass();
+	PlayerControllerClass = APlayerControllerBase::StaticClass();
+	TurretClass = APawnTurret::StaticClass();
+	TankClass = APawnTank::StaticClass();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Read the benchmark settings off the command line, before any players are spawned.
+void ABenchmarkGameModeBase::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FParse::Value(CommandLine, TEXT("BenchTurrets="), NumTurrets);
+	FParse::Value(CommandLine, TEXT("BenchTanks="), NumTanks);
+	FParse::Value(CommandLine, TEXT("BenchFrames="), NumFrames);
+
+	// The plain C++ classes have no meshes or projectiles set, so we normally want the Blueprint ones here.
+	FString ClassPath;
+	if (FParse::Value(CommandLine, TEXT("BenchTurretClass="), ClassPath)) {
+		if (UClass* LoadedClass = LoadClass<APawnTurret>(nullptr, *ClassPath)) {
+			TurretClass = LoadedClass;
+		}
+	}
+	if (FParse::Value(CommandLine, TEXT("BenchTankClass="), ClassPath)) {
+		if (UClass* LoadedClass = LoadClass<APawnTank>(nullptr, *ClassPath)) {
+			TankClass = LoadedClass;
+		}
+	}
+	DefaultPawnClass = TankClass;
+}
+
+// -------------------------------------------------------------------------------------------
+void ABenchmarkGameModeBase::BeginPlay()
+{
+	Super::BeginPlay();
+
+	PostPhysicsTickFunction.Target = this;
+	PostPhysicsTickFunction.TickGroup = TG_PostPhysics;
+	PostPhysicsTickFunction.bCanEverTick = true;
+	PostPhysicsTickFunction.RegisterTickFunction(GetLevel());
+
+	Frames.Reserve(NumFrames);
+
+	// Wait a frame, so the World has finished BeginPlay and our spawned pawns get theirs like normal.
+	GetWorldTimerManager().SetTimerForNextTick(this, &ABenchmarkGameModeBase::SpawnBenchmarkPawns);
+}
+
+// -------------------------------------------------------------------------------------------
+void ABenchmarkGameModeBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	PostPhysicsTickFunction.UnRegisterTickFunction();
+	Super::EndPlay(EndPlayReason);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Start of the frame's physics window.
+void ABenchmarkGameModeBase::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+	PrePhysicsTime = FPlatformTime::Seconds();
+}
+
+// -------------------------------------------------------------------------------------------
+/// End of the frame's physics window. Record this frame, and finish up once we have enough.
+void ABenchmarkGameModeBase::PostPhysicsTick()
+{
+	if (!IsRecording) {
+		return;
+	}
+
+	UProjectilePoolSubsystem* ProjectilePool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+	UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>();
+
+	FBenchmarkFrame& Row = Frames.AddDefaulted_GetRef();
+	Row.Frame = Frames.Num() - 1;
+	Row.DeltaMs = GetWorld()->GetDeltaSeconds() * 1000;
+	// GGameThreadTime is the last finished frame's game thread time (same number "stat unit" shows).
+	Row.GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	// Everything between TG_PrePhysics and TG_PostPhysics, which is mostly the physics simulation.
+	Row.PhysicsMs = (FPlatformTime::Seconds() - PrePhysicsTime) * 1000;
+	Row.ProjectilesFired = ProjectilePool ? ProjectilePool->GetPoolHits() + ProjectilePool->GetPoolMisses() : 0;
+	Row.ProjectilesSpawned = ProjectilePool ? ProjectilePool->GetPoolMisses() : 0;
+	Row.TurretsAlive = TurretManager ? TurretManager->GetNumTurrets() : 0;
+	Row.UsedMemoryMB = FPlatformMemory::GetStats().UsedPhysical / (1024.f * 1024.f);
+
+	if (Frames.Num() >= NumFrames) {
+		FinishBenchmark();
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Spawn NumTurrets turrets in a square grid around the player, and NumTanks tanks in a ring around them.
+void ABenchmarkGameModeBase::SpawnBenchmarkPawns()
+{
+	APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	const FVector Center = PlayerPawn ? PlayerPawn->GetActorLocation() : FVector::ZeroVector;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	const int32 GridSide = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(NumTurrets)));
+	for (int32 Index = 0; Index < NumTurrets; Index++) {
+		const float X = (Index % GridSide - GridSide / 2) * TurretSpacing;
+		const float Y = (Index / GridSide - GridSide / 2) * TurretSpacing;
+		// Leave the middle cell free, that's where the player tank is sitting.
+		if (X == 0 && Y == 0) {
+			continue;
+		}
+		GetWorld()->SpawnActor<APawnTurret>(TurretClass, Center + FVector(X, Y, 0), FRotator::ZeroRotator, SpawnParams);
+	}
+
+	const float TankRingRadius = GridSide * TurretSpacing / 4;
+	for (int32 Index = 0; Index < NumTanks; Index++) {
+		const float Angle = 2 * PI * Index / NumTanks;
+		const FVector Offset = FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0) * TankRingRadius;
+		GetWorld()->SpawnActor<APawnTank>(TankClass, Center + Offset, FRotator::ZeroRotator, SpawnParams);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Benchmark: spawned %d turrets and %d tanks, recording %d frames."),
+		NumTurrets, NumTanks, NumFrames);
+	IsRecording = true;
+}
+
+// -------------------------------------------------------------------------------------------
+void ABenchmarkGameModeBase::FinishBenchmark()
+{
+	IsRecording = false;
+	WriteCSV();
+
+	float TotalGameThreadMs = 0;
+	float TotalPhysicsMs = 0;
+	for (const FBenchmarkFrame& Row : Frames) {
+		TotalGameThreadMs += Row.GameThreadMs;
+		TotalPhysicsMs += Row.PhysicsMs;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Benchmark done: %d frames, avg game thread %.3f ms, avg physics %.3f ms."),
+		Frames.Num(), TotalGameThreadMs / Frames.Num(), TotalPhysicsMs / Frames.Num());
+
+	FPlatformMisc::RequestExit(false);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Saved/Profiling/Benchmarks/ToonTanks-<Turrets>t-<Tanks>k-<date>.csv
+void ABenchmarkGameModeBase::WriteCSV() const
+{
+	FString CSV = TEXT("Frame,DeltaMs,GameThreadMs,PhysicsMs,ProjectilesFired,ProjectilesSpawned,TurretsAlive,UsedMemoryMB\n");
+	for (const FBenchmarkFrame& Row : Frames) {
+		CSV += FString::Printf(TEXT("%d,%.3f,%.3f,%.3f,%d,%d,%d,%.1f\n"),
+			Row.Frame, Row.DeltaMs, Row.GameThreadMs, Row.PhysicsMs,
+			Row.ProjectilesFired, Row.ProjectilesSpawned, Row.TurretsAlive, Row.UsedMemoryMB);
+	}
+
+	const FString FileName = FString::Printf(TEXT("ToonTanks-%dt-%dk-%s.csv"),
+		NumTurrets, NumTanks, *FDateTime::Now().ToString());
+	const FString FilePath = FPaths::Combine(FPaths::ProfilingDir(), TEXT("Benchmarks"), FileName);
+
+	if (FFileHelper::SaveStringToFile(CSV, *FilePath)) {
+		UE_LOG(LogTemp, Display, TEXT("Benchmark results written to %s"), *FilePath);
+	}
+	else {
+		UE_LOG(LogTemp, Error, TEXT("Unable to write benchmark results to %s"), *FilePath);
+	}
+}
@@ -0,0 +1,115 @@
+// -------------------------------------------------------------------------------------------
+/* Headless benchmark run, for catching performance regressions on a build box.
+ *
+ * Example (from the project folder):
+ *   UE4Editor ToonTanks.uproject /Game/Maps/Main?game=/Script/ToonTanks.BenchmarkGameModeBase
+ *       -game -nullrhi -nosound -unattended -benchmark -fps=60
+ *       -BenchTurrets=500 -BenchTanks=8 -BenchFrames=1800
+ *       -BenchTurretClass=/Game/Path/To/BP_PawnTurret.BP_PawnTurret_C
+ *       -BenchTankClass=/Game/Path/To/BP_PawnTank.BP_PawnTank_C
+ *
+ * "-benchmark -fps=60" makes every frame a fixed 1/60s, so runs are repeatable no matter how fast the box is.
+ * Results go to Saved/Profiling/Benchmarks/ as a CSV with one row per frame, then the game quits.
+*/
+// -------------------------------------------------------------------------------------------
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TankGameModeBase.h"
+
+#include "BenchmarkGameModeBase.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class ABenchmarkGameModeBase;
+
+// -------------------------------------------------------------------------------------------
+/// Second tick for the benchmark GameMode, after physics, so we can time the physics part of the frame.
+USTRUCT()
+struct FBenchmarkPostPhysicsTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	ABenchmarkGameModeBase* Target = nullptr;
+
+	virtual void ExecuteTick(
+		float DeltaTime,
+		ELevelTick TickType,
+		ENamedThreads::Type CurrentThread,
+		const FGraphEventRef& MyCompletionGraphEvent
+		) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FBenchmarkPostPhysicsTickFunction> : public TStructOpsTypeTraitsBase2<FBenchmarkPostPhysicsTickFunction>
+{
+	enum { WithCopy = false };
+};
+
+// -------------------------------------------------------------------------------------------
+/// One CSV row. Plain numbers only, so recording a frame never allocates or formats strings.
+struct FBenchmarkFrame
+{
+	int32 Frame;
+	float DeltaMs;
+	float GameThreadMs;
+	float PhysicsMs;
+	int32 ProjectilesFired;
+	int32 ProjectilesSpawned;
+	int32 TurretsAlive;
+	float UsedMemoryMB;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Spawns a grid of turrets and a handful of tanks, runs for a fixed number of frames,
+ * and writes per-frame timings, spawn counts and memory to a CSV. See notes at top for how to run it.
+ */
+UCLASS()
+class TOONTANKS_API ABenchmarkGameModeBase : public ATankGameModeBase
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	ABenchmarkGameModeBase();
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void Tick(float DeltaSeconds) override;
+	void PostPhysicsTick();
+
+protected:
+	// ---------------------------------------------------------
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(EditDefaultsOnly, Category="Benchmark")
+	TSubclassOf<APawnTurret> TurretClass;
+	UPROPERTY(EditDefaultsOnly, Category="Benchmark")
+	TSubclassOf<APawnTank> TankClass;
+
+	/// Number of turrets to spawn (-BenchTurrets=).
+	UPROPERTY(EditDefaultsOnly, Category="Benchmark")
+	int32 NumTurrets = 200;
+	/// Number of extra tanks to spawn on top of the player's (-BenchTanks=).
+	UPROPERTY(EditDefaultsOnly, Category="Benchmark")
+	int32 NumTanks = 4;
+	/// Frames to record before writing the CSV and quitting (-BenchFrames=).
+	UPROPERTY(EditDefaultsOnly, Category="Benchmark")
+	int32 NumFrames = 1200;
+	/// Distance between turrets in the spawn grid.
+	UPROPERTY(EditDefaultsOnly, Category="Benchmark")
+	float TurretSpacing = 600;
+
+private:
+	// ---------------------------------------------------------
+	void SpawnBenchmarkPawns();
+	void FinishBenchmark();
+	void WriteCSV() const;
+
+	FBenchmarkPostPhysicsTickFunction PostPhysicsTickFunction;
+
+	TArray<FBenchmarkFrame> Frames;
+	double PrePhysicsTime = 0;
+	bool IsRecording = false;
+};
@@ -16,6 +16,7 @@
 #include "ToonTanks/Pawns/PawnTurret.h"
 #include "Kismet/GameplayStatics.h"
 #include "ToonTanks/PlayerControllers/PlayerControllerBase.h"
+#include "ToonTanks/Subsystems/TurretManagerSubsystem.h"
 
 
 // -------------------------------------------------------------------------------------------
@@ -29,33 +30,47 @@ void ATankGameModeBase::BeginPlay()
 /// What to do with dead actors (player or NPC).
 void ATankGameModeBase::ActorDied(AActor* DeadActor)
 {
-	UE_LOG(LogTemp, Warning, TEXT("Actor %s died! Bye-bye."), *DeadActor->GetName());
+	// If a player died then we kill it, and once they're all dead it's game over man.
+	if (APawnTank* DeadTank = Cast<APawnTank>(DeadActor)) {
+		DeadTank->HandleDestruction();
 
-	// If the player died then we kill it and game over man.
-	if (DeadActor == PlayerTank) {
-		PlayerTank->HandleDestruction();
-		HandleGameOver(false);
-
-		if (PlayerControllerRef) {
-			PlayerControllerRef->SetPlayerEnabledState(false);
+		if (APlayerControllerBase* DeadPlayer = Cast<APlayerControllerBase>(DeadTank->GetController())) {
+			DeadPlayer->SetPlayerEnabledState(false);
+		}
+		if (!IsAnyPlayerAlive()) {
+			HandleGameOver(false);
 		}
 	}
 	// If a turret died, then we go here.
 	else if (APawnTurret* DestroyedTurret = Cast<APawnTurret>(DeadActor)) {
+		// The turret takes itself out of the TurretManagerSubsystem here, so the count below is already updated.
 		DestroyedTurret->HandleDestruction();
 
-		UpdateTurretsAlive();
-		if (Turrets.Num() == 0) {
+		UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>();
+		if (TurretManager && TurretManager->GetNumTurrets() == 0) {
 			HandleGameOver(true);
 		}
 	}
 }
 
+// -------------------------------------------------------------------------------------------
+/// Whether any player (local or remote) still has a live tank.
+bool ATankGameModeBase::IsAnyPlayerAlive() const
+{
+	for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator) {
+		APlayerController* PlayerController = Iterator->Get();
+		APawnTank* Tank = PlayerController ? Cast<APawnTank>(PlayerController->GetPawn()) : nullptr;
+		if (Tank && Tank->IsPlayerAlive()) {
+			return true;
+		}
+	}
+	return false;
+}
+
 // -------------------------------------------------------------------------------------------
 /// Call the GameStart() Blueprint function.
 void ATankGameModeBase::HandleGameStart()
 {
-	UpdateTurretsAlive();
 	PlayerTank = Cast<APawnTank>(UGameplayStatics::GetPlayerPawn(this, 0));
 	PlayerControllerRef = Cast<APlayerControllerBase>(UGameplayStatics::GetPlayerController(this, 0));
 	GameStart();
@@ -86,14 +101,3 @@ void ATankGameModeBase::HandleGameOver(bool PlayerWon)
 {
 	GameOver(PlayerWon);
 }
-
-// -------------------------------------------------------------------------------------------
-/// Get array of current turrets alive. \n Update Turrets array. \n Update TurretsAliveAmt.
-void ATankGameModeBase::UpdateTurretsAlive()
-{
-	// We'll get a list of all our turrets.
-	UGameplayStatics::GetAllActorsOfClass(
-		GetWorld(),						// World context.
-		APawnTurret::StaticClass(),		// Class of actor we're looking for. See notes at top.
-		OUT Turrets);					// Where to store the result.
-}
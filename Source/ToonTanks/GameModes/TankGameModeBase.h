@@ -10,6 +10,7 @@
 
 // -------------------------------------------------------------------------------------------
 // Forward declarations.
+class APawnBase;
 class APawnTurret;
 class APawnTank;
 
@@ -22,20 +23,23 @@ class TOONTANKS_API ATankGameModeBase : public AGameModeBase
 
 public:
 	void ActorDied(AActor* DeadActor);
+	/// Called by the DamageSubsystem every time an actor actually loses (or gains) health.
+	virtual void ActorDamaged(AActor* DamagedActor, float HealthLost) {}
+	/// Called by every pawn each time it fires a projectile.
+	virtual void PawnFired(APawnBase* Shooter) {}
 
 private:
 	UPROPERTY()
 	APawnTank* PlayerTank;
 	UPROPERTY()
-	TArray<AActor*> Turrets;
-	UPROPERTY()
 	APlayerControllerBase* PlayerControllerRef;
 	void HandleGameStart();
-	void HandleGameOver(bool PlayerWon);
-	void UpdateTurretsAlive();
+	bool IsAnyPlayerAlive() const;
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void HandleGameOver(bool PlayerWon);
+	APawnTank* GetPlayerTank() const { return PlayerTank; }
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Game Loop")
 	int32 StartDelay = 3;
@@ -4,8 +4,18 @@
 #include "PawnBase.h"
 
 #include "Kismet/GameplayStatics.h"
+#include "Net/UnrealNetwork.h"
 #include "ToonTanks/Actors/ProjectileBase.h"
 #include "ToonTanks/Components/HealthComponent.h"
+#include "ToonTanks/GameModes/TankGameModeBase.h"
+#include "ToonTanks/Subsystems/AudioEventSubsystem.h"
+#include "ToonTanks/Subsystems/EffectsSubsystem.h"
+#include "ToonTanks/Subsystems/PawnSpatialGridSubsystem.h"
+#include "ToonTanks/Subsystems/ProjectilePoolSubsystem.h"
+#include "ToonTanks/Subsystems/ProjectileSimulationSubsystem.h"
+#include "ToonTanks/Subsystems/SignificanceSubsystem.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
 
 // -------------------------------------------------------------------------------------------
 APawnBase::APawnBase()
@@ -30,6 +40,79 @@ APawnBase::APawnBase()
 
 	// Not a physical object so no need to attach to anything.
 	HealthComponent = CreateDefaultSubobject<UHealthComponent>(TEXT("Health Component"));
+
+	// The server runs the game, clients get our turret yaw, deaths and shots from it.
+	bReplicates = true;
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	// Whoever's driving aims on their own machine, so only everyone else needs it.
+	DOREPLIFETIME_CONDITION(APawnBase, ReplicatedTurretYaw, COND_SkipOwner);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called when the game starts or when spawned.
+void APawnBase::BeginPlay()
+{
+	Super::BeginPlay();
+	// Make sure there are projectiles of our type waiting in the pool before we start shooting.
+	// Lightweight ones never come from the pool, so don't bother spawning any.
+	const bool IsSimulated = ProjectileClass && ProjectileClass->GetDefaultObject<AProjectileBase>()->UsesLightweightSimulation();
+	UProjectilePoolSubsystem* ProjectilePool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>();
+	if (ProjectilePool && !IsSimulated) {
+		ProjectilePool->Prewarm(ProjectileClass);
+	}
+	// Show up in range queries (e.g. "which turrets can see the tank?").
+	if (UPawnSpatialGridSubsystem* SpatialGrid = GetWorld()->GetSubsystem<UPawnSpatialGridSubsystem>()) {
+		SpatialGrid->RegisterPawn(this);
+	}
+	// Tick slower and drop our LOD when nobody's close enough to tell.
+	BaseTickInterval = GetActorTickInterval();
+	if (USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>()) {
+		Significance->RegisterPawn(this);
+	}
+	// On a fixed timestep, child classes do their movement and firing in SimulationStep().
+	// Only the server simulates, clients get the results replicated.
+	USimulationClockSubsystem* Clock = GetWorld()->GetSubsystem<USimulationClockSubsystem>();
+	if (Clock && Clock->IsFixedStep() && HasAuthority()) {
+		SimulationClock = Clock;
+		SetSimulationStepEnabled(true);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called when we're destroyed or the level is unloaded.
+void APawnBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPawnSpatialGridSubsystem* SpatialGrid = GetWorld()->GetSubsystem<UPawnSpatialGridSubsystem>()) {
+		SpatialGrid->UnregisterPawn(this);
+	}
+	if (USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>()) {
+		Significance->UnregisterPawn(this);
+	}
+	SetSimulationStepEnabled(false);
+	SimulationClock = nullptr;
+	Super::EndPlay(EndPlayReason);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Bind or unbind SimulationStep() on the SimulationClock. Does nothing when we're not on a fixed timestep.
+void APawnBase::SetSimulationStepEnabled(bool Enabled)
+{
+	if (!SimulationClock || Enabled == SimulationStepHandle.IsValid()) {
+		return;
+	}
+
+	if (Enabled) {
+		SimulationStepHandle = SimulationClock->OnStep.AddUObject(this, &APawnBase::SimulationStep);
+	}
+	else {
+		SimulationClock->OnStep.Remove(SimulationStepHandle);
+		SimulationStepHandle.Reset();
+	}
 }
 
 // -------------------------------------------------------------------------------------------
@@ -50,17 +133,109 @@ void APawnBase::RotateTurret(FVector LookAtTarget)
 }
 
 // -------------------------------------------------------------------------------------------
-/// Spawn Projectile at Location, firing towards Rotation.
+/// Same end result as RotateTurret(), for when the yaw has already been worked out elsewhere
+/// (like the TurretManagerSubsystem aiming all the turrets at once).
+void APawnBase::SetTurretYaw(float Yaw)
+{
+	TurretMesh->SetWorldRotation(FRotator(0, Yaw, 0));
+	if (HasAuthority()) {
+		ReplicatedTurretYaw = FRotator::CompressAxisToShort(Yaw);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+float APawnBase::GetHealth() const
+{
+	return HealthComponent ? HealthComponent->GetHealth() : 0;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Skips AActor::TakeDamage() on purpose: none of our damage is point or radial damage that needs
+/// scaling, and its OnTakeAnyDamage broadcast is a reflected call per hit nobody needs any more.
+float APawnBase::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
+{
+	if (!CanBeDamaged() || !HealthComponent || DamageAmount == 0) {
+		return 0;
+	}
+
+	HealthComponent->ApplyDamage(DamageAmount, UHealthComponent::GetDamageInstigator(EventInstigator, DamageCauser));
+	return DamageAmount;
+}
+
+// -------------------------------------------------------------------------------------------
+/// One Cast, which is a lot cheaper than checking for each pawn class in turn.
+EPawnTags APawnBase::GetTagsOf(const AActor* Actor)
+{
+	const APawnBase* Pawn = Cast<APawnBase>(Actor);
+	return Pawn ? Pawn->PawnTags : EPawnTags::None;
+}
+
+// -------------------------------------------------------------------------------------------
+FVector APawnBase::GetAimDirection() const
+{
+	return TurretMesh->GetForwardVector();
+}
+
+// -------------------------------------------------------------------------------------------
+FVector APawnBase::GetMuzzleLocation() const
+{
+	return ProjectileSpawnPoint->GetComponentLocation();
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnBase::SetLaunchPitch(float Pitch)
+{
+	LaunchPitch = Pitch;
+	HasLaunchPitch = true;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Fixed step pawns move and fire in SimulationStep(), which doesn't care about our tick interval.
+void APawnBase::SetSignificanceTier(ESignificanceTier Tier)
+{
+	SetActorTickInterval(FMath::Max(BaseTickInterval, USignificanceSubsystem::GetTickInterval(Tier)));
+	const int32 ForcedLod = USignificanceSubsystem::GetForcedLod(Tier);
+	BaseMesh->SetForcedLodModel(ForcedLod);
+	TurretMesh->SetForcedLodModel(ForcedLod);
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnBase::ReplicateTurretYaw()
+{
+	ReplicatedTurretYaw = FRotator::CompressAxisToShort(TurretMesh->GetComponentRotation().Yaw);
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnBase::OnRep_TurretYaw()
+{
+	TurretMesh->SetWorldRotation(FRotator(0, FRotator::DecompressAxisFromShort(ReplicatedTurretYaw), 0));
+}
+
+// -------------------------------------------------------------------------------------------
+/// Launch a Projectile from the pool at Location, firing towards Rotation.
 void APawnBase::Fire()
 {
+	TOONTANKS_SCOPE_CYCLE(Fire);
+
 	// Ensures we don't run and crash if we forget to set the type of projectile in the editor.
-	if (ProjectileClass) {
+	// Only the server fires for real, clients hear about it through MulticastFireProjectile().
+	if (ProjectileClass && HasAuthority()) {
 		FVector Location = ProjectileSpawnPoint->GetComponentLocation();
 		FRotator Rotation = ProjectileSpawnPoint->GetComponentRotation();
-		// Spawn a new TempProjectile.
-		AProjectileBase* TempProjectile = GetWorld()->SpawnActor<AProjectileBase>(ProjectileClass, Location, Rotation);
-		// Setting the owner helps, for example, down the line to ensure we don't shoot ourselves.
-		TempProjectile->SetOwner(this);
+		if (HasLaunchPitch) {
+			Rotation.Pitch = LaunchPitch;
+		}
+		LaunchProjectile(Location, Rotation);
+		if (GetNetMode() != NM_Standalone) {
+			MulticastFireProjectile(
+				Location,
+				FRotator::CompressAxisToShort(Rotation.Yaw),
+				FRotator::CompressAxisToShort(Rotation.Pitch));
+		}
+		// Let the GameMode keep score (shots fired) if it cares.
+		if (ATankGameModeBase* GameMode = GetWorld()->GetAuthGameMode<ATankGameModeBase>()) {
+			GameMode->PawnFired(this);
+		}
 	}
 }
 
@@ -70,11 +245,8 @@ void APawnBase::Fire()
 /// Visualize destruction, inform GameMode of pawn death, etc.
 void APawnBase::HandleDestruction()
 {
-	// Spawns death particle at actor location.
-	UGameplayStatics::SpawnEmitterAtLocation(this, DeathParticle, GetActorLocation());
-	UGameplayStatics::PlaySoundAtLocation(this, ExplosionSound, GetActorLocation());
-	// Shake camera!
-	ShakeCamera(DeathShake);
+	// Particle, sound and camera shake, everywhere.
+	MulticastDeathEffects();
 	/*
 		Child Class overrides:
 			- In PawnTurret:
@@ -87,8 +259,55 @@ void APawnBase::HandleDestruction()
 	*/
 }
 
-/// Shake the camera for the FirstPLayerController given the type of BP_Shake we want to use.
+// -------------------------------------------------------------------------------------------
+/// Client side of Fire(). The server already launched the real projectile, so only clients do anything here.
+void APawnBase::MulticastFireProjectile_Implementation(FVector_NetQuantize10 Location, uint16 Yaw, uint16 Pitch)
+{
+	if (HasAuthority() || !ProjectileClass) {
+		return;
+	}
+
+	const FRotator Rotation(FRotator::DecompressAxisFromShort(Pitch), FRotator::DecompressAxisFromShort(Yaw), 0);
+	LaunchProjectile(Location, Rotation);
+}
+
+// -------------------------------------------------------------------------------------------
+/// We pass ourselves as owner, which helps down the line to ensure we don't shoot ourselves.
+void APawnBase::LaunchProjectile(const FVector& Location, const FRotator& Rotation)
+{
+	if (ProjectileClass->GetDefaultObject<AProjectileBase>()->UsesLightweightSimulation()) {
+		if (UProjectileSimulationSubsystem* Simulation = GetWorld()->GetSubsystem<UProjectileSimulationSubsystem>()) {
+			Simulation->Launch(ProjectileClass, Location, Rotation, this);
+		}
+		return;
+	}
+
+	// Grab a projectile from the pool (it only spawns a new one if the pool ran dry).
+	if (UProjectilePoolSubsystem* ProjectilePool = GetWorld()->GetSubsystem<UProjectilePoolSubsystem>()) {
+		ProjectilePool->AcquireProjectile(ProjectileClass, Location, Rotation, this);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Spawns death particle and sound at actor location, and shakes the camera of anyone close enough.
+void APawnBase::MulticastDeathEffects_Implementation()
+{
+	if (UEffectsSubsystem* Effects = GetWorld()->GetSubsystem<UEffectsSubsystem>()) {
+		Effects->SpawnEffect(DeathParticle, GetActorLocation());
+	}
+	if (UAudioEventSubsystem* AudioEvents = GetWorld()->GetSubsystem<UAudioEventSubsystem>()) {
+		AudioEvents->PlaySoundAtLocation(ExplosionSound, GetActorLocation(), ToonTanksSoundPriority::Death);
+	}
+	// Shake camera! Only shakes local players, which is why this is in the multicast.
+	UGameplayStatics::PlayWorldCameraShake(this, DeathShake, GetActorLocation(), 0, DeathShakeRadius);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Shake the camera of whoever is driving this pawn (if it's a player), given the type of BP_Shake we want to use.
 void APawnBase::ShakeCamera(TSubclassOf<UMatineeCameraShake> ShakeType)
 {
-	GetWorld()->GetFirstPlayerController()->ClientStartCameraShake(ShakeType, CameraShakeScale);
+	// ClientStartCameraShake is a client RPC, so this also works for remote players when called on the server.
+	if (APlayerController* PlayerController = Cast<APlayerController>(GetController())) {
+		PlayerController->ClientStartCameraShake(ShakeType, CameraShakeScale);
+	}
 }
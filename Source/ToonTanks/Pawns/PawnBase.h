@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 
 #include "Components/CapsuleComponent.h"
+#include "Engine/NetSerialization.h"
 #include "GameFramework/Pawn.h"
 #include "PawnBase.generated.h"
 
@@ -13,6 +14,21 @@
 class APawnTank;
 class AProjectileBase;
 class UHealthComponent;
+class USimulationClockSubsystem;
+enum class ESignificanceTier : uint8;
+
+// -------------------------------------------------------------------------------------------
+/// What a projectile needs to know about a pawn it hits, as bits. Classifying a hit is then
+/// one mask test, instead of asking the class hierarchy "are you a turret? are you a tank?".
+enum class EPawnTags : uint8
+{
+	None = 0,
+	/// Direct hits damage it.
+	Damageable = 1 << 0,
+	Tank = 1 << 1,
+	Turret = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EPawnTags);
 
 // -------------------------------------------------------------------------------------------
 /// This is the base class for our pawns (both the tank and the immobile turrets).
@@ -27,6 +43,31 @@ public:
 	APawnBase();
 	// To be overridden in any child classes.
 	virtual void HandleDestruction();
+	/// Point the TurretMesh towards Yaw (in degrees, world space) without tilting it.
+	void SetTurretYaw(float Yaw);
+	/// How far away this pawn can see (and shoot) things. 0 if it doesn't go looking for targets.
+	virtual float GetThreatRange() const { return 0; }
+	float GetHealth() const;
+	UHealthComponent* GetHealthComponent() const { return HealthComponent; }
+	EPawnTags GetTags() const { return PawnTags; }
+	/// Actor's tags if it's one of our pawns, None for anything else (the floor, a wall, a physics crate).
+	static EPawnTags GetTagsOf(const AActor* Actor);
+	/// Which way our turret is pointing.
+	FVector GetAimDirection() const;
+	/// Where our projectiles get launched from.
+	FVector GetMuzzleLocation() const;
+	TSubclassOf<AProjectileBase> GetProjectileClass() const { return ProjectileClass; }
+	/// Launch projectiles at Pitch (in degrees, up is positive) instead of however ProjectileSpawnPoint is set up.
+	/// The turret mesh stays level, it's just the shot that goes up (see the UBallisticsSubsystem).
+	void SetLaunchPitch(float Pitch);
+	/// Back to launching along ProjectileSpawnPoint.
+	void ClearLaunchPitch() { HasLaunchPitch = false; }
+	/// Called by the USignificanceSubsystem when we move into a new tier: slows our tick down and drops our mesh LOD.
+	virtual void SetSignificanceTier(ESignificanceTier Tier);
+	/// Straight into our HealthComponent's UDamageSubsystem slot. No OnTakeAnyDamage or AnyDamage Blueprint event per hit
+	/// (bind to the HealthComponent's OnHealthThresholdCrossed and OnDied instead).
+	virtual float TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 private:
 	// ---------------------------------------------------------
@@ -49,8 +90,46 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta=(AllowPrivateAccess = "true"))
 	UHealthComponent* HealthComponent;
 
+	/// Everyone within this distance of a death gets their camera shaken.
+	UPROPERTY(EditAnywhere, Category="Effects")
+	float DeathShakeRadius = 4000;
+
+	/// TurretMesh's world yaw, squashed into 16 bits (about 0.005 degrees, plenty for a turret).
+	UPROPERTY(ReplicatedUsing=OnRep_TurretYaw)
+	uint16 ReplicatedTurretYaw = 0;
+	UFUNCTION()
+	void OnRep_TurretYaw();
+
+	/// Projectiles aren't replicated actors. The server tells clients where one was fired from,
+	/// and they launch their own look-alike from their pool (no damage, just the visuals and sound).
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFireProjectile(FVector_NetQuantize10 Location, uint16 Yaw, uint16 Pitch);
+	/// Launch one of our projectiles from the pool, or the UProjectileSimulationSubsystem if the class uses it.
+	void LaunchProjectile(const FVector& Location, const FRotator& Rotation);
+	/// Death particle, sound and camera shake, on the server and every client.
+	UFUNCTION(NetMulticast, Reliable)
+	void MulticastDeathEffects();
+
+	/// Set by SetLaunchPitch(). Until then we fire along ProjectileSpawnPoint.
+	float LaunchPitch = 0;
+	bool HasLaunchPitch = false;
+
+	/// Our slot in the USignificanceSubsystem arrays (INDEX_NONE when not registered).
+	int32 SignificanceIndex = INDEX_NONE;
+	friend class USignificanceSubsystem;
+	/// Whatever tick interval we were set up with, so a High tier never ticks us faster than that.
+	float BaseTickInterval = 0;
+
+	/// Only set when the World runs on a fixed timestep (see USimulationClockSubsystem).
+	UPROPERTY()
+	USimulationClockSubsystem* SimulationClock;
+	FDelegateHandle SimulationStepHandle;
+
 
 protected:
+	/// Called when the game starts or when spawned.
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	void ShakeCamera(TSubclassOf<UMatineeCameraShake> ShakeType);
 	// UMatineeCameraShake is a legacy Camera Shake. The new one is CameraShakeBase.
 	UPROPERTY(EditAnywhere, Category="Effects")
@@ -59,6 +138,8 @@ protected:
 	TSubclassOf<UMatineeCameraShake> ShotShake;
 	UPROPERTY(EditAnywhere, Category="Effects")
 	float CameraShakeScale = 1;
+	/// Set once in the constructor (child classes add their own kind). Not AActor::Tags, those are FNames.
+	EPawnTags PawnTags = EPawnTags::Damageable;
 
 	// ---------------------------------------------------------
 	/// Simple collision shape for our pawn.
@@ -76,4 +157,14 @@ protected:
 	// ---------------------------------------------------------
 	void RotateTurret(FVector LookAtTarget);
 	virtual void Fire();
+	/// Server only: send TurretMesh's current yaw to clients (it only goes out if it changed).
+	void ReplicateTurretYaw();
+
+	// ---------------------------------------------------------
+	/// True when movement and firing should happen in SimulationStep() instead of Tick/timers.
+	bool IsFixedStep() const { return SimulationClock != nullptr; }
+	/// Called once per fixed simulation step (only when IsFixedStep()). To be overridden in child classes.
+	virtual void SimulationStep(float StepSeconds) {}
+	/// Start or stop getting SimulationStep() calls. On by default from BeginPlay when IsFixedStep().
+	void SetSimulationStepEnabled(bool Enabled);
 };
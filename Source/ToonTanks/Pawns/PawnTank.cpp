@@ -6,6 +6,10 @@
 
 #include "Camera/CameraComponent.h"
 #include "GameFramework/SpringArmComponent.h"
+#include "Net/UnrealNetwork.h"
+#include "ToonTanks/ToonTanksStats.h"
+#include "ToonTanks/Subsystems/PawnSpatialGridSubsystem.h"
+#include "ToonTanks/Subsystems/SceneQuerySubsystem.h"
 
 // -------------------------------------------------------------------------------------------
 APawnTank::APawnTank()
@@ -14,6 +18,17 @@ APawnTank::APawnTank()
 	SpringArm->SetupAttachment(TurretMesh);
 	Camera = CreateDefaultSubobject<UCameraComponent>(TEXT("Camera"));
 	Camera->SetupAttachment(SpringArm);
+
+	// The server moves every tank, clients just get told where they are.
+	SetReplicatingMovement(true);
+	PawnTags |= EPawnTags::Tank;
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnTank::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(APawnTank, PlayerAlive);
 }
 
 // -------------------------------------------------------------------------------------------
@@ -24,7 +39,11 @@ void APawnTank::BeginPlay()
 	// so we can reference it later.
 	PlayerController = Cast<APlayerController>(GetController());
 
-	CreateFireRateTimer();
+	// On a fixed timestep the fire rate is counted in SimulationStep() instead.
+	// Clients never fire themselves, so they don't need the timer at all.
+	if (!IsFixedStep() && HasAuthority()) {
+		CreateFireRateTimer();
+	}
 }
 
 // -------------------------------------------------------------------------------------------
@@ -35,7 +54,44 @@ void APawnTank::HandleDestruction()
 
 	SetActorHiddenInGame(true);
 	SetActorTickEnabled(false);
+	// On a fixed timestep we move in SimulationStep(), not Tick(), so that needs stopping too.
+	SetSimulationStepEnabled(false);
+	MoveInput = 0;
+	TurnInput = 0;
+	IsFiring = false;
+
+}
+
+// -------------------------------------------------------------------------------------------
+/// MoveInput and TurnInput get applied every step (or frame, for remote players) until they change,
+/// so a key held down when input goes off would otherwise keep us driving.
+void APawnTank::DisableInput(APlayerController* PlayerController)
+{
+	Super::DisableInput(PlayerController);
+	HasInputEnabled = false;
+	const bool WasFiring = IsFiring;
+	MoveInput = 0;
+	TurnInput = 0;
+	IsFiring = false;
+	if (IsAutopilot) {
+		return;
+	}
+
+	// The server drives our tank on the last input we sent it, so tell it we've stopped now rather than
+	// at the next resend. The resends carry on with the zeros, in case this one gets lost.
+	if (!HasAuthority() && IsLocallyControlled()) {
+		SendInputToServer(true);
+		if (WasFiring) {
+			ServerSetFiring(false);
+		}
+	}
+}
 
+// -------------------------------------------------------------------------------------------
+void APawnTank::EnableInput(APlayerController* PlayerController)
+{
+	Super::EnableInput(PlayerController);
+	HasInputEnabled = true;
 }
 
 // -------------------------------------------------------------------------------------------
@@ -45,6 +101,40 @@ bool APawnTank::IsPlayerAlive()
 	return PlayerAlive;
 }
 
+// -------------------------------------------------------------------------------------------
+/// Turn the autopilot on or off. Either way, we start out not moving and not firing.
+void APawnTank::SetAutopilot(bool Enabled)
+{
+	IsAutopilot = Enabled;
+	IsFiring = false;
+	MoveInput = 0;
+	TurnInput = 0;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Same as the player's MoveTank(), RotateTank() and FireToggle() inputs, for the autopilot.
+void APawnTank::SetAutopilotInput(float Move, float Turn, bool Fire)
+{
+	if (!IsAutopilot) {
+		return;
+	}
+
+	IsFiring = Fire;
+	if (IsFixedStep()) {
+		MoveInput = Move;
+		TurnInput = Turn;
+		return;
+	}
+	ApplyMove(Move, GetWorld()->DeltaTimeSeconds);
+	ApplyRotation(Turn, GetWorld()->DeltaTimeSeconds);
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnTank::AimAt(const FVector& Target)
+{
+	RotateTurret(Target);
+}
+
 // -------------------------------------------------------------------------------------------
 void APawnTank::Tick(float DeltaTime)
 {
@@ -54,6 +144,60 @@ void APawnTank::Tick(float DeltaTime)
 		// LookAtMouse();
 	}
 
+	if (!HasAuthority()) {
+		if (IsLocallyControlled()) {
+			SendInputToServer();
+		}
+		return;
+	}
+
+	// Remote players' input arrives through ServerSetInput(), so we drive them from here.
+	// (On a fixed timestep SimulationStep() already does this for everyone.)
+	if (!IsLocallyControlled() && !IsFixedStep() && !IsAutopilot) {
+		ApplyMove(MoveInput, DeltaTime);
+		ApplyRotation(TurnInput, DeltaTime);
+	}
+	ReplicateTurretYaw();
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnTank::SendInputToServer(bool Force)
+{
+	const int8 Move = FMath::RoundToInt(FMath::Clamp(MoveInput, -1.f, 1.f) * 127);
+	const int8 Turn = FMath::RoundToInt(FMath::Clamp(TurnInput, -1.f, 1.f) * 127);
+	const uint16 TurretYaw = FRotator::CompressAxisToShort(TurretMesh->GetComponentRotation().Yaw);
+	const float Now = GetWorld()->GetTimeSeconds();
+	const bool IsUnchanged = Move == SentMove && Turn == SentTurn && TurretYaw == SentTurretYaw;
+	if (IsUnchanged && Now - InputSentTime < InputResendInterval && !Force) {
+		return;
+	}
+
+	SentMove = Move;
+	SentTurn = Turn;
+	SentTurretYaw = TurretYaw;
+	InputSentTime = Now;
+	ServerSetInput(Move, Turn, TurretYaw);
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnTank::ServerSetInput_Implementation(int8 Move, int8 Turn, uint16 TurretYaw)
+{
+	// Late (or resent) input from before we died doesn't get to drive us again.
+	if (IsAutopilot || !PlayerAlive) {
+		return;
+	}
+	MoveInput = Move / 127.f;
+	TurnInput = Turn / 127.f;
+	SetTurretYaw(FRotator::DecompressAxisFromShort(TurretYaw));
+}
+
+// -------------------------------------------------------------------------------------------
+void APawnTank::ServerSetFiring_Implementation(bool Firing)
+{
+	if (IsAutopilot) {
+		return;
+	}
+	IsFiring = Firing;
 }
 
 
@@ -70,30 +214,85 @@ void APawnTank::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 }
 
 // -------------------------------------------------------------------------------------------
-/// Determine move speed and direction on x-axis (forward or back). Update MoveDirection.
+/// Handle forward/back input. Moves right away, or on the next fixed step if IsFixedStep().
+/// On a client it's just stored, and sent to the server from Tick().
 void APawnTank::MoveTank(float Input)
+{
+	if (IsAutopilot) {
+		return;
+	}
+	if (IsFixedStep() || !HasAuthority()) {
+		MoveInput = Input;
+		return;
+	}
+	ApplyMove(Input, GetWorld()->DeltaTimeSeconds);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Determine move speed and direction on x-axis (forward or back). Update MoveDirection.
+void APawnTank::ApplyMove(float Input, float DeltaSeconds)
 {
 	// Since we're driving a tank, we won't be strafing, so x-axis only.
-	float X = Input * MoveSpeed * GetWorld()->DeltaTimeSeconds;
+	float X = Input * MoveSpeed * DeltaSeconds;
 	float Y = 0;
 	float Z = 0;
 
 	MoveDirection = FVector(X, Y, Z);
+	// Axis bindings call this every frame, even with no input, so skip the grid update if we didn't move.
+	if (X == 0) {
+		Capsule->ComponentVelocity = FVector::ZeroVector;
+		return;
+	}
+	TOONTANKS_SCOPE_CYCLE(TankMove);
+	TOONTANKS_COUNT(Sweeps, 1);
+	const FVector OldLocation = GetActorLocation();
 	AddActorLocalOffset(MoveDirection, true);
+
+	// We move ourselves instead of through a movement component, so nothing else fills in our velocity.
+	// Turrets lead their shots with it (GetVelocity()), and it goes out with our replicated movement.
+	if (DeltaSeconds > 0) {
+		Capsule->ComponentVelocity = (GetActorLocation() - OldLocation) / DeltaSeconds;
+	}
+
+	// Keep our spot in the spatial grid up to date, so range queries find us where we actually are.
+	if (UPawnSpatialGridSubsystem* SpatialGrid = GetWorld()->GetSubsystem<UPawnSpatialGridSubsystem>()) {
+		SpatialGrid->UpdatePawn(this);
+	}
 }
 
 // -------------------------------------------------------------------------------------------
-/// Determine rotation speed and direction on y-axis (spinning/yaw). Update RotationDirection.
+/// Handle turning input. Turns right away, or on the next fixed step if IsFixedStep().
+/// On a client it's just stored, and sent to the server from Tick().
 void APawnTank::RotateTank(float Input)
+{
+	if (IsAutopilot) {
+		return;
+	}
+	if (IsFixedStep() || !HasAuthority()) {
+		TurnInput = Input;
+		return;
+	}
+	ApplyRotation(Input, GetWorld()->DeltaTimeSeconds);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Determine rotation speed and direction on y-axis (spinning/yaw). Update RotationDirection.
+void APawnTank::ApplyRotation(float Input, float DeltaSeconds)
 {
 	float Pitch = 0;
-	float Yaw = Input * TurnSpeed * GetWorld()->DeltaTimeSeconds;
+	float Yaw = Input * TurnSpeed * DeltaSeconds;
 	float Roll = 0;
 
 	FRotator Rotation = FRotator(Pitch, Yaw, Roll);
 	FRotator CounterRotation = FRotator(Pitch, -Yaw, Roll);
 
 	RotationDirection = FQuat(Rotation);
+	// Same as ApplyMove(), axis bindings call this every frame even with no input, so don't sweep for nothing.
+	if (Yaw == 0) {
+		return;
+	}
+	TOONTANKS_SCOPE_CYCLE(TankMove);
+	TOONTANKS_COUNT(Sweeps, 1);
 	AddActorLocalRotation(RotationDirection, true);
 
 	// Counter rotate the turret so the view stays the same.
@@ -101,22 +300,39 @@ void APawnTank::RotateTank(float Input)
 }
 
 // -------------------------------------------------------------------------------------------
-/// Aim the tank turret towards the mouse cursor location via RotateTurret().
+/// Aim the tank turret towards the mouse cursor location via RotateTurret(). \n
+/// The trace under the cursor goes through the USceneQuerySubsystem, so (with async queries on)
+/// the turret turns a frame later instead of the game thread waiting on the trace.
 void APawnTank::LookAtMouse()
 {
-	if (PlayerController) {
-		FHitResult CursorHit;
-		// This traces from the cursor to the world space. (cool!)
-		PlayerController->GetHitResultUnderCursor(
-			ECC_Visibility,		// The trace channel (in this case, anything visible).
-			false,				// Use complex tracing? No need for subpart hit detection.. yet.
-			OUT CursorHit		// OUT to FHitResult.
-			);
-		// This is the end location we want our tank turret to look at.
-		FVector HitLocation = CursorHit.Location;
-		RotateTurret(HitLocation);
+	if (!PlayerController) {
+		return;
+	}
+	USceneQuerySubsystem* SceneQueries = GetWorld()->GetSubsystem<USceneQuerySubsystem>();
+	if (!SceneQueries) {
+		return;
+	}
 
+	// Turn the cursor into a ray in world space. (cool!)
+	FVector CursorOrigin;
+	FVector CursorDirection;
+	if (!PlayerController->DeprojectMousePositionToWorld(OUT CursorOrigin, OUT CursorDirection)) {
+		return;
 	}
+
+	// Same trace GetHitResultUnderCursor() does: anything visible, no complex collision, as far as the controller looks.
+	const FVector TraceEnd = CursorOrigin + CursorDirection * PlayerController->HitResultTraceDistance;
+	const FCollisionQueryParams Params(SCENE_QUERY_STAT(LookAtMouse), false);
+	TWeakObjectPtr<APawnTank> WeakThis(this);
+
+	SceneQueries->RequestLineTrace(CursorOrigin, TraceEnd, ECC_Visibility, Params,
+		[WeakThis](const TArray<FHitResult>& Hits)
+		{
+			// The hit location is where we want our tank turret to look at.
+			if (WeakThis.IsValid() && Hits.Num() > 0) {
+				WeakThis->RotateTurret(Hits[0].Location);
+			}
+		});
 }
 
 // -------------------------------------------------------------------------------------------
@@ -155,12 +371,38 @@ void APawnTank::CheckFireCondition()
 /// Toggle IsFiring bool. Only ever called on press and on release from "Fire" input.
 void APawnTank::FireToggle()
 {
+	if (IsAutopilot) {
+		return;
+	}
 	if (!IsFiring) {
 		IsFiring = true;
 	}
 	else if (IsFiring) {
 		IsFiring = false;
 	}
+
+	// The server does the actual shooting.
+	if (!HasAuthority()) {
+		ServerSetFiring(IsFiring);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// One fixed simulation step: move and turn with the latest input, and count down to the next shot.
+void APawnTank::SimulationStep(float StepSeconds)
+{
+	if (IsAutopilot) {
+		OnAutopilotStep.Broadcast();
+	}
+	ApplyMove(MoveInput, StepSeconds);
+	ApplyRotation(TurnInput, StepSeconds);
+
+	// Same cadence as the looping FireRateTimer, just counted in steps.
+	FireTimeAccumulator += StepSeconds;
+	while (FireTimeAccumulator >= FireRate) {
+		FireTimeAccumulator -= FireRate;
+		CheckFireCondition();
+	}
 }
 
 // -------------------------------------------------------------------------------------------
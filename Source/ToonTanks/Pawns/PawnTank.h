@@ -27,12 +27,30 @@ public:
 	/// Called to bind functionality to input.
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 	virtual void HandleDestruction() override;
+	/// Also lets go of whatever was held down. The axis bindings stop calling us, so nothing else would.
+	virtual void DisableInput(APlayerController* PlayerController) override;
+	virtual void EnableInput(APlayerController* PlayerController) override;
+	/// False between DisableInput() and EnableInput(), like during the start countdown and after game over.
+	/// The autopilot holds off then too.
+	bool IsInputEnabled() const { return HasInputEnabled; }
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
 	/* Making this function public allows any class to check if the player is alive,
 	 * without needing to expose the actual "IsPlayerAlive" variable, to avoid
 	 * accidentally setting it externally. So, "get" is public, but "set" is private. */
 	bool IsPlayerAlive();
 
+	/// Let something other than the player drive (like UTankAutopilotComponent). Player input is ignored while on.
+	void SetAutopilot(bool Enabled);
+	/// The autopilot's version of the Move/Turn/Fire inputs. Call it every frame while the autopilot is on,
+	/// or from OnAutopilotStep on a fixed timestep.
+	void SetAutopilotInput(float Move, float Turn, bool Fire);
+	/// On a fixed timestep, broadcast at the start of every step while the autopilot is on, before we move.
+	/// That's where the autopilot decides, so its input is never a frame stale and doesn't depend on frame rate.
+	FSimpleMulticastDelegate OnAutopilotStep;
+	/// Point the turret at Target (the autopilot's version of aiming with the mouse).
+	void AimAt(const FVector& Target);
+
 protected:
 	// ---------------------------------------------------------
 	/// Called when the game starts or when spawned.
@@ -42,6 +60,9 @@ private:
 	// ---------------------------------------------------------
 	void MoveTank(float Input);
 	void RotateTank(float Input);
+	void ApplyMove(float Input, float DeltaSeconds);
+	void ApplyRotation(float Input, float DeltaSeconds);
+	virtual void SimulationStep(float StepSeconds) override;
 	void LookAtMouse();
 	/// Alternative to aiming at cursor.
 	void RotateView(float Input);
@@ -50,13 +71,43 @@ private:
 	void FireToggle();
 	virtual void Fire() override;
 
+	/// Clients don't move or shoot themselves, they send their input here and the server does it.
+	/// Move and Turn are -1..1 scaled to -127..127, TurretYaw is compressed like ReplicatedTurretYaw.
+	/// Unreliable, since the turret yaw changes every frame the mouse moves and each send supersedes the last.
+	UFUNCTION(Server, Unreliable)
+	void ServerSetInput(int8 Move, int8 Turn, uint16 TurretYaw);
+	/// Reliable, a lost "stop firing" would keep us shooting.
+	UFUNCTION(Server, Reliable)
+	void ServerSetFiring(bool Firing);
+	/// Client only: send ServerSetInput() if our input changed since the last one,
+	/// or resend it every InputResendInterval in case the last one got lost. Force sends it either way.
+	void SendInputToServer(bool Force = false);
+
 	bool IsFiring = false;
+	UPROPERTY(Replicated)
 	bool PlayerAlive = true;
+	bool IsAutopilot = false;
+	bool HasInputEnabled = true;
+
+	// What we last sent with ServerSetInput(), so we only send changes.
+	int8 SentMove = 0;
+	int8 SentTurn = 0;
+	uint16 SentTurretYaw = 0;
+	float InputSentTime = 0;
+	/// Seconds between resends of unchanged input, so a dropped ServerSetInput() doesn't leave the server on stale input.
+	UPROPERTY(EditAnywhere, Category="Network", meta=(ClampMin="0.02"))
+	float InputResendInterval = 0.2f;
 
 	FVector MoveDirection;
 	FQuat RotationDirection;
 	FTimerHandle FireRateTimerHandle;
 
+	// Used on a fixed timestep, and for remote players on the server: the latest input, applied every
+	// step (or frame), and time towards the next shot.
+	float MoveInput = 0;
+	float TurnInput = 0;
+	float FireTimeAccumulator = 0;
+
 	APlayerController* PlayerController;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Movement", meta=(AllowPrivateAccess = "true"))
@@ -12,14 +12,19 @@ Since Objects do not have physical representations in the World, we can't spawn
 #include "PawnTurret.h"
 
 #include "DrawDebugHelpers.h"
-#include "PawnTank.h"
-#include "Kismet/GameplayStatics.h"
+#include "ToonTanks/Subsystems/TurretManagerSubsystem.h"
 #define OUT
 
 // -------------------------------------------------------------------------------------------
 APawnTurret::APawnTurret()
 {
-	//...
+	// Turrets don't tick, the TurretManagerSubsystem aims all of them in one go every frame.
+	PrimaryActorTick.bCanEverTick = false;
+	PawnTags |= EPawnTags::Turret;
+
+	// We never move, and our yaw only changes while we're aiming at someone.
+	SetReplicatingMovement(false);
+	NetUpdateFrequency = 10;
 }
 
 // -------------------------------------------------------------------------------------------
@@ -27,9 +32,25 @@ void APawnTurret::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// This will start the FireRateTimerHandle, which fires off every "FireRate" seconds.
-	CreateFireRateTimer();
-	PlayerPawn = GetPlayerPawnTank();
+	// We start asleep: no fire rate timer and no fixed steps until Wake() is called.
+	SetSimulationStepEnabled(false);
+
+	// Players far outside our range can't see us shoot or turn, so don't spend bandwidth on them.
+	NetCullDistanceSquared = FMath::Square(ThreatRange * NetRelevancyRangeScale);
+
+	if (UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>()) {
+		TurretManager->RegisterTurret(this, ThreatRange);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called when we're destroyed or the level is unloaded. Stop being aimed by the TurretManagerSubsystem.
+void APawnTurret::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>()) {
+		TurretManager->UnregisterTurret(this);
+	}
+	Super::EndPlay(EndPlayReason);
 }
 
 // -------------------------------------------------------------------------------------------
@@ -39,21 +60,54 @@ void APawnTurret::HandleDestruction()
 	// Call base pawn first to play effects,
 	// then we can do the rest of override logic specific to the turret.
 	Super::HandleDestruction();
+	// Leave the live turret registry right away, so the GameMode's count is correct as soon as we return.
+	if (UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>()) {
+		TurretManager->UnregisterTurret(this);
+	}
 	Destroy();
 }
 
 // -------------------------------------------------------------------------------------------
-void APawnTurret::Tick(float DeltaTime)
+/// The target just came into ThreatRange, so start counting towards the first shot.
+/// This will start the FireRateTimerHandle, which fires off every "FireRate" seconds.
+/// On a fixed timestep SimulationStep() counts the fire rate instead.
+void APawnTurret::Wake()
 {
-	Super::Tick(DeltaTime);
-	// If there is no player, or the player is out of range, do nothing.
-	if (!PlayerPawn || DistanceToPlayer() > ThreatRange) {
+	if (Awake) {
 		return;
 	}
-	// Otherwise, move our turret head's aim/rotation towards the Player.
-	RotateTurret(PlayerPawn->GetActorLocation());
+	Awake = true;
+
+	// When a tank rolls into range of a whole field of turrets, they all wake up on the same frame.
+	// Giving each turret its own phase keeps them from all firing on the same frames from then on.
+	const float FirstShotDelay = FireRate * (0.5f + GetFirePhase());
+	if (IsFixedStep()) {
+		FireTimeAccumulator = FireRate - FirstShotDelay;
+		SetSimulationStepEnabled(true);
+	}
+	else {
+		CreateFireRateTimer(FirstShotDelay);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// 0 to 1, different for every turret but the same every run (it's from our name), so fixed step runs repeat.
+float APawnTurret::GetFirePhase() const
+{
+	return (FCrc::StrCrc32(*GetName()) % 1024) / 1024.f;
+}
 
+// -------------------------------------------------------------------------------------------
+/// The target left ThreatRange (or died), so there's nothing for us to do until it comes back.
+void APawnTurret::Sleep()
+{
+	if (!Awake) {
+		return;
+	}
+	Awake = false;
 
+	GetWorldTimerManager().ClearTimer(FireRateTimerHandle);
+	SetSimulationStepEnabled(false);
 }
 
 // -------------------------------------------------------------------------------------------
@@ -64,21 +118,19 @@ void APawnTurret::CheckFireCondition()
 		DrawDebugSphere(GetWorld(), GetActorLocation(), ThreatRange, 8, Blue, false, 2, 0, 1);
 	}
 
-	// If the player doesn't exist or is dead, return.
-	if (!PlayerPawn || !PlayerPawn->IsPlayerAlive() ) {
-		return;
-	}
-
-	// If they're alive and in range, fire!
-	if (DistanceToPlayer() <= ThreatRange) {
+	// If any live player is in range, and we've turned to face them, fire!
+	// The TurretManagerSubsystem already worked out the range and aim this frame, so we just ask it.
+	UTurretManagerSubsystem* TurretManager = GetWorld()->GetSubsystem<UTurretManagerSubsystem>();
+	if (TurretManager && TurretManager->IsReadyToFire(this)) {
 		Fire();
 	}
 
 }
 
 // -------------------------------------------------------------------------------------------
-/// Create a timer that will dictate the turret's fire rate.\n\n <b>OUT</b> to <i>FireRateTimerHandle</i>.
-void APawnTurret::CreateFireRateTimer()
+/// Create a timer that will dictate the turret's fire rate, first going off after FirstDelay.\n\n
+/// <b>OUT</b> to <i>FireRateTimerHandle</i>.
+void APawnTurret::CreateFireRateTimer(float FirstDelay)
 {
 	FTimerManager& TimerManager = GetWorld()->GetTimerManager();
 
@@ -87,34 +139,18 @@ void APawnTurret::CreateFireRateTimer()
 		this,							  // Reference to this class.
 		&APawnTurret::CheckFireCondition, // The memory location of the function we'll be firing off.
 		FireRate,						  // The amount of time (in seconds) between set and firing.
-		true							  // Keep looping/firing at our set FireRate intervals.
+		true,							  // Keep looping/firing at our set FireRate intervals.
+		FirstDelay						  // Time until the first shot, after that it's every FireRate.
 		);
 }
 
 // -------------------------------------------------------------------------------------------
-/// Get the distance from this Turret to the Player.
-float APawnTurret::DistanceToPlayer()
+/// One fixed simulation step. Same cadence as the looping FireRateTimer, just counted in steps.
+void APawnTurret::SimulationStep(float StepSeconds)
 {
-	// Technically GetDistance should never be called if the player doesn't exist,
-	// but this is extra backup anyway.
-	if (!PlayerPawn) {
-		return 0;
+	FireTimeAccumulator += StepSeconds;
+	while (FireTimeAccumulator >= FireRate) {
+		FireTimeAccumulator -= FireRate;
+		CheckFireCondition();
 	}
-
-	// All of this could be done on one line, but the verbosity helps me remember later.
-	FVector PlayerLocation = PlayerPawn->GetActorLocation();
-	FVector TurretLocation = GetActorLocation();
-
-	float Distance = FVector::Dist(PlayerLocation, TurretLocation);
-	return Distance;
-}
-
-// -------------------------------------------------------------------------------------------
-/// Retrieve player pawn at 0 index (Player One). Return as PawnTank reference.
-APawnTank* APawnTurret::GetPlayerPawnTank()
-{
-	// This retrieves our player pawn at 0 index (player 1), and stores it as a APawnTank class (converted with a Cast).
-	// See above notes why we have to pass in "this".
-	APawnTank* PawnRef = Cast<APawnTank>(UGameplayStatics::GetPlayerPawn(this, 0));
-	return PawnRef;
 }
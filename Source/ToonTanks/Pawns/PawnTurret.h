@@ -8,10 +8,20 @@
 
 // -------------------------------------------------------------------------------------------
 // Forward declarations.
-class APawnTank;
 class USpringArmComponent;
 class UCameraComponent;
 
+// -------------------------------------------------------------------------------------------
+/// Which tank in range a turret goes after.
+UENUM(BlueprintType)
+enum class ETurretTargetPolicy : uint8
+{
+	Nearest,
+	LowestHealth,
+	/// The one whose turret is pointing most directly at us.
+	MostThreatening,
+};
+
 // -------------------------------------------------------------------------------------------
 /**
  * Our Enemy AI turrets.
@@ -25,9 +35,15 @@ public:
 	// ---------------------------------------------------------
 	/// Sets default values for this pawn's properties.
 	APawnTurret();
-	/// Called every frame.
-	virtual void Tick(float DeltaTime) override;
 	virtual void HandleDestruction() override;
+	virtual float GetThreatRange() const override { return ThreatRange; }
+	/// Something came into ThreatRange: start the fire rate timer (or fixed steps). Called by the TurretManagerSubsystem.
+	void Wake();
+	/// Nothing in ThreatRange anymore: stop the fire rate timer (or fixed steps). Called by the TurretManagerSubsystem.
+	void Sleep();
+	bool IsAwake() const { return Awake; }
+	ETurretTargetPolicy GetTargetPolicy() const { return TargetPolicy; }
+	float GetTurnRate() const { return TurnRate; }
 
 private:
 	// ---------------------------------------------------------
@@ -37,23 +53,40 @@ private:
 	float ThreatRange = 2500;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Combat", meta=(AllowPrivateAccess = "true"))
 	bool EnableDebug = false;
-
-	UPROPERTY() APawnTank* PlayerPawn;
+	/// Read once when we start, changing it afterwards does nothing.
+	UPROPERTY(EditAnywhere, Category="Combat")
+	ETurretTargetPolicy TargetPolicy = ETurretTargetPolicy::Nearest;
+	/// How fast we can swing round to face a target, in degrees per second. 0 snaps straight to it.
+	/// Read once when we start, changing it afterwards does nothing.
+	UPROPERTY(EditAnywhere, Category="Combat", meta=(ClampMin="0"))
+	float TurnRate = 180;
+	/// Clients further than ThreatRange * this stop getting updates about us (turret yaw, shots fired).
+	UPROPERTY(EditAnywhere, Category="Network", meta=(ClampMin="1"))
+	float NetRelevancyRangeScale = 2;
 
 	FColor Blue = FColor(0, 0, 255, 255);
 
 	FVector PlayerPosition;
 	FVector TurretPosition;
 	FTimerHandle FireRateTimerHandle;
+	/// Only used on a fixed timestep: time counted towards the next CheckFireCondition().
+	float FireTimeAccumulator = 0;
+	/// Turrets start dormant, with no timer running, until the TurretManagerSubsystem sees a target in range.
+	bool Awake = false;
+
+	/// Our slot in the TurretManagerSubsystem arrays (INDEX_NONE when not registered).
+	int32 ManagerIndex = INDEX_NONE;
+	friend class UTurretManagerSubsystem;
 
 	void CheckFireCondition();
-	void CreateFireRateTimer();
-	float DistanceToPlayer();
-	APawnTank* GetPlayerPawnTank();
+	void CreateFireRateTimer(float FirstDelay);
+	float GetFirePhase() const;
+	virtual void SimulationStep(float StepSeconds) override;
 
 protected:
 	// ---------------------------------------------------------
 	/// Called when the game starts or when spawned.
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 };
@@ -5,6 +5,14 @@
 
 void APlayerControllerBase::SetPlayerEnabledState(bool SetPlayerEnabled)
 {
+	if (!IsLocalController()) {
+		ClientSetPlayerEnabledState(SetPlayerEnabled);
+		return;
+	}
+	if (!GetPawn()) {
+		return;
+	}
+
 	if (SetPlayerEnabled) {
 		GetPawn()->EnableInput(this);
 	}
@@ -17,3 +25,8 @@ void APlayerControllerBase::SetPlayerEnabledState(bool SetPlayerEnabled)
 	// bShowMouseCursor = SetPlayerEnabled;
 
 }
+
+void APlayerControllerBase::ClientSetPlayerEnabledState_Implementation(bool SetPlayerEnabled)
+{
+	SetPlayerEnabledState(SetPlayerEnabled);
+}
@@ -15,6 +15,11 @@ class TOONTANKS_API APlayerControllerBase : public APlayerController
 	GENERATED_BODY()
 
 public:
+	/// Turn the player's input on or off. Safe to call on the server for remote players too.
 	void SetPlayerEnabledState(bool SetPlayerEnabled);
 
+private:
+	/// Input lives on the player's own machine, so remote players get told to do it there.
+	UFUNCTION(Client, Reliable)
+	void ClientSetPlayerEnabledState(bool SetPlayerEnabled);
 };
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AudioEventSubsystem.h"
+
+#include "Engine/Engine.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundBase.h"
+#include "ToonTanks/Subsystems/SignificanceSubsystem.h"
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<int32> CVarAudioMaxOneShots(
+	TEXT("ToonTanks.Audio.MaxOneShots"),
+	24,
+	TEXT("How many gameplay one-shots can be playing at once before new ones get culled."));
+
+static TAutoConsoleVariable<float> CVarAudioDedupeWindow(
+	TEXT("ToonTanks.Audio.DedupeWindow"),
+	0.25f,
+	TEXT("Seconds during which the same sound in the same cell only plays once."));
+
+static TAutoConsoleVariable<float> CVarAudioDedupeCellSize(
+	TEXT("ToonTanks.Audio.DedupeCellSize"),
+	300.f,
+	TEXT("Size of the cells used to decide if two sounds are 'in the same spot'."));
+
+/// Type "ToonTanks.Audio.Stats" in the console to see how many sounds got culled.
+static FAutoConsoleCommandWithWorld AudioStatsCommand(
+	TEXT("ToonTanks.Audio.Stats"),
+	TEXT("Print how many gameplay sound events were played versus culled."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UAudioEventSubsystem* AudioEvents = World ? World->GetSubsystem<UAudioEventSubsystem>() : nullptr) {
+			AudioEvents->LogStats();
+		}
+	}));
+
+/// Looping sounds report a huge duration, don't let those hog the budget forever.
+static constexpr float MaxTrackedDuration = 5;
+
+// -------------------------------------------------------------------------------------------
+void UAudioEventSubsystem::Deinitialize()
+{
+	PendingEvents.Empty();
+	LastPlayedTimes.Empty();
+	ActiveEndTimes.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void UAudioEventSubsystem::Tick(float DeltaTime)
+{
+	FlushEvents();
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType UAudioEventSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+bool UAudioEventSubsystem::IsTickable() const
+{
+	return PendingEvents.Num() > 0;
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* UAudioEventSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId UAudioEventSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAudioEventSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+void UAudioEventSubsystem::PlaySoundAtLocation(USoundBase* Sound, const FVector& Location, float Priority)
+{
+	// Same as PlaySoundAtLocation(), no sound set in the editor just means no sound.
+	if (!Sound) {
+		return;
+	}
+	// Small sounds in a far away battle never make the cut anyway, so don't even queue them.
+	USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	if (Significance && !Significance->ShouldPlaySound(Location, Priority)) {
+		NumCulled++;
+		return;
+	}
+	PendingEvents.Add({Sound, Location, Priority});
+}
+
+// -------------------------------------------------------------------------------------------
+void UAudioEventSubsystem::LogStats() const
+{
+	const int32 Total = NumPlayed + NumCulled;
+	const float CulledPercent = Total > 0 ? 100.f * NumCulled / Total : 0.f;
+	UE_LOG(LogTemp, Display, TEXT("Audio events: %d played, %d culled (%.1f%% culled), %d one-shots playing."),
+		NumPlayed, NumCulled, CulledPercent, ActiveEndTimes.Num());
+}
+
+// -------------------------------------------------------------------------------------------
+/// De-duplicate, rank, and play as many of this frame's sound events as the budget allows.
+void UAudioEventSubsystem::FlushEvents()
+{
+	UWorld* World = GetWorld();
+	const float Now = World->GetTimeSeconds();
+	const float DedupeWindow = CVarAudioDedupeWindow.GetValueOnGameThread();
+
+	// Forget one-shots that should have finished by now.
+	ActiveEndTimes.RemoveAllSwap([Now](float EndTime) { return EndTime <= Now; }, false);
+
+	// Where the player hears from. Without a listener we just rank by priority.
+	FVector ListenerLocation = FVector::ZeroVector;
+	bool HasListener = false;
+	// The local player, not just the first one (on a listen server that could be a remote player's).
+	if (APlayerController* PlayerController = GEngine->GetFirstLocalPlayerController(World)) {
+		FVector FrontDir;
+		FVector RightDir;
+		PlayerController->GetAudioListenerPosition(ListenerLocation, FrontDir, RightDir);
+		HasListener = true;
+	}
+
+	// Closer and more important sounds go first. Dividing by distance (in meters) keeps nearby
+	// small sounds competitive with big explosions on the other side of the map.
+	auto Score = [&](const FAudioEvent& Event)
+	{
+		const float DistanceMeters = HasListener ? FVector::Dist(Event.Location, ListenerLocation) / 100 : 0;
+		return Event.Priority / (1 + DistanceMeters);
+	};
+	PendingEvents.Sort([&](const FAudioEvent& A, const FAudioEvent& B) { return Score(A) > Score(B); });
+
+	int32 Budget = CVarAudioMaxOneShots.GetValueOnGameThread() - ActiveEndTimes.Num();
+
+	for (const FAudioEvent& Event : PendingEvents) {
+		// Same sound, same spot, just played? That's a duplicate.
+		float& LastPlayed = LastPlayedTimes.FindOrAdd({Event.Sound, GetCell(Event.Location)}, -BIG_NUMBER);
+		if (Now - LastPlayed < DedupeWindow || Budget <= 0) {
+			NumCulled++;
+			continue;
+		}
+
+		LastPlayed = Now;
+		Budget--;
+		NumPlayed++;
+		ActiveEndTimes.Add(Now + FMath::Min(Event.Sound->GetDuration(), MaxTrackedDuration));
+		UGameplayStatics::PlaySoundAtLocation(World, Event.Sound, Event.Location);
+	}
+	PendingEvents.Reset();
+
+	// Don't let the de-dupe map grow forever on long matches.
+	if (LastPlayedTimes.Num() > 1024) {
+		for (auto It = LastPlayedTimes.CreateIterator(); It; ++It) {
+			if (Now - It.Value() >= DedupeWindow) {
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+FIntVector UAudioEventSubsystem::GetCell(const FVector& Location) const
+{
+	const float CellSize = FMath::Max(CVarAudioDedupeCellSize.GetValueOnGameThread(), 1.f);
+	return FIntVector(
+		FMath::FloorToInt(Location.X / CellSize),
+		FMath::FloorToInt(Location.Y / CellSize),
+		FMath::FloorToInt(Location.Z / CellSize));
+}
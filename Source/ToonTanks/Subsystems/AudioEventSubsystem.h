@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+
+#include "AudioEventSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class USoundBase;
+
+// -------------------------------------------------------------------------------------------
+/// Rough priorities for our one-shots. When the voice budget is full, higher (and closer) wins.
+namespace ToonTanksSoundPriority
+{
+	constexpr float Impact = 1;
+	constexpr float Launch = 2;
+	constexpr float DirectImpact = 3;
+	constexpr float Explosion = 4;
+	constexpr float Death = 5;
+}
+
+// -------------------------------------------------------------------------------------------
+/// A sound someone asked for this frame.
+struct FAudioEvent
+{
+	USoundBase* Sound;
+	FVector Location;
+	float Priority;
+};
+
+// -------------------------------------------------------------------------------------------
+/// "This sound, around here". Two events with the same key close together in time only play once.
+struct FAudioEventKey
+{
+	USoundBase* Sound;
+	FIntVector Cell;
+
+	bool operator==(const FAudioEventKey& Other) const
+	{
+		return Sound == Other.Sound && Cell == Other.Cell;
+	}
+
+	friend uint32 GetTypeHash(const FAudioEventKey& Key)
+	{
+		return HashCombine(GetTypeHash(Key.Sound), GetTypeHash(Key.Cell));
+	}
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Every gameplay one-shot goes through here instead of straight to PlaySoundAtLocation(). \n
+ * Requests are collected during the frame, then at the end of it: the same sound in the same
+ * spot (cell) within a short window only plays once, the rest are ranked by priority and
+ * distance to the listener, and only as many as fit in the one-shot budget actually play.
+ */
+UCLASS()
+class TOONTANKS_API UAudioEventSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Ask for Sound to be played at Location at the end of this frame (if it makes the cut).
+	void PlaySoundAtLocation(USoundBase* Sound, const FVector& Location, float Priority);
+
+	int32 GetNumPlayed() const { return NumPlayed; }
+	int32 GetNumCulled() const { return NumCulled; }
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	void FlushEvents();
+	FIntVector GetCell(const FVector& Location) const;
+
+	TArray<FAudioEvent> PendingEvents;
+	/// When each (sound, cell) pair last played, for de-duplicating within the window.
+	TMap<FAudioEventKey, float> LastPlayedTimes;
+	/// When each one-shot we've started is expected to finish. Used to count what's still playing.
+	TArray<float> ActiveEndTimes;
+
+	int32 NumPlayed = 0;
+	int32 NumCulled = 0;
+};
@@ -0,0 +1,291 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BallisticsSubsystem.h"
+
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "ToonTanks/Actors/ProjectileBase.h"
+#include "ToonTanks/Subsystems/WeaponDefinitionSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+
+// -------------------------------------------------------------------------------------------
+// Table layout. Launch pitches we try, and the grid the results get resampled onto.
+namespace BallisticTableLayout
+{
+	constexpr float MinPitch = -30;
+	constexpr float MaxPitch = 70;
+	constexpr float PitchStep = 1;
+	constexpr float MinHeight = -600;
+	constexpr float HeightStep = 100;
+	constexpr int32 NumHeights = 13;
+	constexpr int32 NumRanges = 64;
+	/// Same ballpark as a 60-120 fps frame, which is what the real projectile moves at.
+	constexpr float StepSeconds = 1.f / 120.f;
+	constexpr float MaxFlightSeconds = 10;
+	/// How many times LeadTarget() moves the aim point to where the target will be when we land.
+	constexpr int32 LeadPasses = 2;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.Ballistics.Stats" in the console to see which tables got built and how far they reach.
+static FAutoConsoleCommandWithWorld BallisticsStatsCommand(
+	TEXT("ToonTanks.Ballistics.Stats"),
+	TEXT("Print the ballistic tables built for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UBallisticsSubsystem* Ballistics = World ? World->GetSubsystem<UBallisticsSubsystem>() : nullptr) {
+			Ballistics->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+/// Bilinear blend of the four grid points around Range and Height. Anything off the grid is clamped to its edge.
+FBallisticSolution FBallisticTable::Lookup(float Range, float Height) const
+{
+	const float RangeIndex = FMath::Clamp(Range / RangeStep, 0.f, static_cast<float>(NumRanges - 1));
+	const float HeightIndex = FMath::Clamp((Height - MinHeight) / HeightStep, 0.f, static_cast<float>(NumHeights - 1));
+
+	const int32 R0 = FMath::FloorToInt(RangeIndex);
+	const int32 H0 = FMath::FloorToInt(HeightIndex);
+	const int32 R1 = FMath::Min(R0 + 1, NumRanges - 1);
+	const int32 H1 = FMath::Min(H0 + 1, NumHeights - 1);
+	const float RangeAlpha = RangeIndex - R0;
+	const float HeightAlpha = HeightIndex - H0;
+
+	auto Blend = [&](const TArray<float>& Values)
+	{
+		const float Low = FMath::Lerp(Values[H0 * NumRanges + R0], Values[H0 * NumRanges + R1], RangeAlpha);
+		const float High = FMath::Lerp(Values[H1 * NumRanges + R0], Values[H1 * NumRanges + R1], RangeAlpha);
+		return FMath::Lerp(Low, High, HeightAlpha);
+	};
+
+	FBallisticSolution Solution;
+	Solution.Pitch = Blend(Pitches);
+	Solution.FlightTime = Blend(FlightTimes);
+	return Solution;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Look up the flight time to where the target is now, move the aim point to where it'll be by then,
+/// and repeat once more from there. Tanks are slow next to a grenade, so two passes land close enough.
+FVector FBallisticTable::LeadTarget(const FVector& Muzzle, const FVector& Target, const FVector& TargetVelocity,
+	FBallisticSolution& OutSolution) const
+{
+	FVector AimPoint = Target;
+	for (int32 Pass = 0; Pass < BallisticTableLayout::LeadPasses; Pass++) {
+		const FVector ToAim = AimPoint - Muzzle;
+		OutSolution = Lookup(ToAim.Size2D(), ToAim.Z);
+		AimPoint = Target + TargetVelocity * OutSolution.FlightTime;
+	}
+
+	const FVector ToAim = AimPoint - Muzzle;
+	OutSolution = Lookup(ToAim.Size2D(), ToAim.Z);
+	return AimPoint;
+}
+
+// -------------------------------------------------------------------------------------------
+void UBallisticsSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UWeaponDefinitionSubsystem* Weapons = Cast<UWeaponDefinitionSubsystem>(
+		Collection.InitializeDependency(UWeaponDefinitionSubsystem::StaticClass()));
+	if (Weapons) {
+		Weapons->OnWeaponsChanged.AddUObject(this, &UBallisticsSubsystem::RebuildTables);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Launch speeds may have changed. Tables get rebuilt in place, so pointers handed out by GetTable() stay good.
+void UBallisticsSubsystem::RebuildTables()
+{
+	const double StartSeconds = FPlatformTime::Seconds();
+	for (TPair<UClass*, TUniquePtr<FBallisticTable>>& Entry : Tables) {
+		TUniquePtr<FBallisticTable> NewTable = BuildTable(Entry.Key);
+		if (!Entry.Value) {
+			Entry.Value = MoveTemp(NewTable);
+		}
+		// A projectile that stopped falling keeps its old table, since turrets might be holding on to it.
+		else if (NewTable) {
+			*Entry.Value = MoveTemp(*NewTable);
+		}
+	}
+	BuildSeconds += FPlatformTime::Seconds() - StartSeconds;
+}
+
+// -------------------------------------------------------------------------------------------
+void UBallisticsSubsystem::Deinitialize()
+{
+	Tables.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+const FBallisticTable* UBallisticsSubsystem::GetTable(TSubclassOf<AProjectileBase> ProjectileClass)
+{
+	if (!ProjectileClass) {
+		return nullptr;
+	}
+
+	if (TUniquePtr<FBallisticTable>* Table = Tables.Find(ProjectileClass)) {
+		return Table->Get();
+	}
+
+	const double StartSeconds = FPlatformTime::Seconds();
+	TUniquePtr<FBallisticTable>& Table = Tables.Add(ProjectileClass, BuildTable(ProjectileClass));
+	BuildSeconds += FPlatformTime::Seconds() - StartSeconds;
+	return Table.Get();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Fly the projectile once per launch pitch, noting the range and time at which it comes down through
+/// each height on the grid. Then, for each height, turn "pitch -> range" around into "range -> pitch"
+/// on evenly spaced ranges. Returns null for projectiles that don't fall (there's no arc to work out).
+TUniquePtr<FBallisticTable> UBallisticsSubsystem::BuildTable(TSubclassOf<AProjectileBase> ProjectileClass) const
+{
+	using namespace BallisticTableLayout;
+	TOONTANKS_SCOPE_CYCLE(BallisticsBuild);
+
+	// Speeds come from the projectile's weapon. Gravity scale is a Blueprint edit to its projectile movement,
+	// which lives on the class default object's component.
+	const AProjectileBase* Projectile = ProjectileClass->GetDefaultObject<AProjectileBase>();
+	const UProjectileMovementComponent* Movement = Projectile->GetProjectileMovement();
+	UWeaponDefinitionSubsystem* Weapons = GetWorld()->GetSubsystem<UWeaponDefinitionSubsystem>();
+	if (!Movement || !Weapons) {
+		return nullptr;
+	}
+
+	const FWeaponDefinition& Weapon = Weapons->GetWeapon(Weapons->FindWeaponId(Projectile));
+	const float LaunchSpeed = Weapon.MoveSpeedStart;
+	const float MaxSpeed = Weapon.MoveSpeedMax;
+	const float GravityZ = GetWorld()->GetGravityZ() * Movement->ProjectileGravityScale;
+	if (LaunchSpeed <= 0 || GravityZ >= 0) {
+		return nullptr;
+	}
+
+	// Where each pitch comes down through each height. Valid is false if it never does.
+	struct FCrossing
+	{
+		float Range = 0;
+		float Time = 0;
+		bool Valid = false;
+	};
+	const int32 NumPitches = FMath::FloorToInt((MaxPitch - MinPitch) / PitchStep) + 1;
+	TArray<FCrossing> Crossings;
+	Crossings.SetNum(NumPitches * NumHeights);
+
+	for (int32 PitchIndex = 0; PitchIndex < NumPitches; PitchIndex++) {
+		const float Pitch = MinPitch + PitchIndex * PitchStep;
+		FVector2D Velocity(LaunchSpeed * FMath::Cos(FMath::DegreesToRadians(Pitch)),
+			LaunchSpeed * FMath::Sin(FMath::DegreesToRadians(Pitch)));
+		FVector2D Position = FVector2D::ZeroVector;
+
+		for (float Time = 0; Time < MaxFlightSeconds; Time += StepSeconds) {
+			// Same integration UProjectileMovementComponent does: gravity, MaxSpeed, then average the two velocities.
+			FVector2D NewVelocity = Velocity + FVector2D(0, GravityZ * StepSeconds);
+			if (MaxSpeed > 0 && NewVelocity.SizeSquared() > FMath::Square(MaxSpeed)) {
+				NewVelocity = NewVelocity.GetSafeNormal() * MaxSpeed;
+			}
+			const FVector2D NewPosition = Position + (Velocity + NewVelocity) * (0.5f * StepSeconds);
+
+			for (int32 HeightIndex = 0; HeightIndex < NumHeights; HeightIndex++) {
+				FCrossing& Crossing = Crossings[PitchIndex * NumHeights + HeightIndex];
+				const float Height = MinHeight + HeightIndex * HeightStep;
+				if (Crossing.Valid || Position.Y <= Height || NewPosition.Y > Height) {
+					continue;
+				}
+				const float Alpha = (Position.Y - Height) / (Position.Y - NewPosition.Y);
+				Crossing.Range = FMath::Lerp(Position.X, NewPosition.X, Alpha);
+				Crossing.Time = Time + Alpha * StepSeconds;
+				Crossing.Valid = true;
+			}
+
+			Velocity = NewVelocity;
+			Position = NewPosition;
+			if (Position.Y < MinHeight) {
+				break;
+			}
+		}
+	}
+
+	// The grid goes out as far as the longest throw at any height.
+	float MaxRange = 0;
+	for (const FCrossing& Crossing : Crossings) {
+		MaxRange = Crossing.Valid ? FMath::Max(MaxRange, Crossing.Range) : MaxRange;
+	}
+	if (MaxRange <= 0) {
+		return nullptr;
+	}
+
+	TUniquePtr<FBallisticTable> Table = MakeUnique<FBallisticTable>();
+	Table->NumRanges = NumRanges;
+	Table->RangeStep = MaxRange / (NumRanges - 1);
+	Table->NumHeights = NumHeights;
+	Table->MinHeight = MinHeight;
+	Table->HeightStep = HeightStep;
+	Table->Pitches.SetNumZeroed(NumRanges * NumHeights);
+	Table->FlightTimes.SetNumZeroed(NumRanges * NumHeights);
+
+	TArray<int32> LowArc;
+	for (int32 HeightIndex = 0; HeightIndex < NumHeights; HeightIndex++) {
+		// Range goes up with pitch until the longest throw, then comes back down for the high arc, which we skip.
+		LowArc.Reset();
+		for (int32 PitchIndex = 0; PitchIndex < NumPitches; PitchIndex++) {
+			const FCrossing& Crossing = Crossings[PitchIndex * NumHeights + HeightIndex];
+			if (!Crossing.Valid) {
+				continue;
+			}
+			if (LowArc.Num() > 0 && Crossing.Range <= Crossings[LowArc.Last() * NumHeights + HeightIndex].Range) {
+				break;
+			}
+			LowArc.Add(PitchIndex);
+		}
+
+		float* RowPitches = &Table->Pitches[HeightIndex * NumRanges];
+		float* RowFlightTimes = &Table->FlightTimes[HeightIndex * NumRanges];
+
+		// Too high to reach at all: lob it the same as one row down, which is the best we can do.
+		if (LowArc.Num() == 0) {
+			if (HeightIndex > 0) {
+				FMemory::Memcpy(RowPitches, RowPitches - NumRanges, NumRanges * sizeof(float));
+				FMemory::Memcpy(RowFlightTimes, RowFlightTimes - NumRanges, NumRanges * sizeof(float));
+			}
+			continue;
+		}
+
+		// Ranges go up along the row and along LowArc, so one walk through both does it.
+		int32 Sample = 0;
+		for (int32 RangeIndex = 0; RangeIndex < NumRanges; RangeIndex++) {
+			const float Range = RangeIndex * Table->RangeStep;
+			while (Sample + 1 < LowArc.Num() && Crossings[LowArc[Sample + 1] * NumHeights + HeightIndex].Range < Range) {
+				Sample++;
+			}
+
+			const int32 Next = FMath::Min(Sample + 1, LowArc.Num() - 1);
+			const FCrossing& Low = Crossings[LowArc[Sample] * NumHeights + HeightIndex];
+			const FCrossing& High = Crossings[LowArc[Next] * NumHeights + HeightIndex];
+			const float Span = High.Range - Low.Range;
+			const float Alpha = Span > 0 ? FMath::Clamp((Range - Low.Range) / Span, 0.f, 1.f) : 0.f;
+
+			RowPitches[RangeIndex] = MinPitch + FMath::Lerp<float>(LowArc[Sample], LowArc[Next], Alpha) * PitchStep;
+			RowFlightTimes[RangeIndex] = FMath::Lerp(Low.Time, High.Time, Alpha);
+		}
+	}
+
+	return Table;
+}
+
+// -------------------------------------------------------------------------------------------
+void UBallisticsSubsystem::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Ballistics: %d table(s), built in %.2f ms"), Tables.Num(), BuildSeconds * 1000.0);
+	for (const TPair<UClass*, TUniquePtr<FBallisticTable>>& Entry : Tables) {
+		if (Entry.Value) {
+			UE_LOG(LogTemp, Log, TEXT("  %s: reaches %.0f at most"),
+				*GetNameSafe(Entry.Key), Entry.Value->GetMaxRange());
+		}
+		else {
+			UE_LOG(LogTemp, Log, TEXT("  %s: no arc (doesn't fall), aimed flat"), *GetNameSafe(Entry.Key));
+		}
+	}
+}
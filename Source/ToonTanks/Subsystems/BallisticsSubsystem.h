@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "BallisticsSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class AProjectileBase;
+
+// -------------------------------------------------------------------------------------------
+/// How to launch a projectile so it comes down on a point: the pitch to fire at, and how long it takes to get there.
+struct FBallisticSolution
+{
+	float Pitch = 0;
+	float FlightTime = 0;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Launch pitch and flight time for one projectile class, on a grid of horizontal range by height
+ * (target Z minus muzzle Z), both evenly spaced so a lookup is just some index math and a bilinear blend. \n
+ * Only the low arc is stored, and the projectile is always on its way down when it gets there
+ * (which is how a grenade lands on a tank anyway). Out of reach ranges get the longest throw we've got.
+ */
+struct FBallisticTable
+{
+	float RangeStep = 0;
+	int32 NumRanges = 0;
+	float MinHeight = 0;
+	float HeightStep = 0;
+	int32 NumHeights = 0;
+	/// Both indexed [HeightIndex * NumRanges + RangeIndex].
+	TArray<float> Pitches;
+	TArray<float> FlightTimes;
+
+	FBallisticSolution Lookup(float Range, float Height) const;
+	/// Where to aim (and at what pitch) to hit a target at Target moving at TargetVelocity, fired from Muzzle.
+	FVector LeadTarget(const FVector& Muzzle, const FVector& Target, const FVector& TargetVelocity,
+		FBallisticSolution& OutSolution) const;
+	float GetMaxRange() const { return RangeStep * (NumRanges - 1); }
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Builds and hands out an FBallisticTable for every projectile class that gets fired at something,
+ * so aiming with gravity, MaxSpeed and a moving target is a couple of table lookups instead of an iterative solve. \n
+ * Tables are built the first time a class is asked for (turrets ask in BeginPlay), by flying the projectile
+ * the same way UProjectileMovementComponent does at a fixed small step, once per launch pitch.
+ * They're rebuilt when the weapon table is reloaded.
+ */
+UCLASS()
+class TOONTANKS_API UBallisticsSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// The table for ProjectileClass, built now if this is the first time anyone asked. Null if there's no class.
+	/// The table lives as long as this subsystem, so it's fine to hang on to the pointer.
+	const FBallisticTable* GetTable(TSubclassOf<AProjectileBase> ProjectileClass);
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	TUniquePtr<FBallisticTable> BuildTable(TSubclassOf<AProjectileBase> ProjectileClass) const;
+	/// Called when the weapon table is reloaded.
+	void RebuildTables();
+
+	/// Projectile classes stick around for the whole level, and so do we.
+	TMap<UClass*, TUniquePtr<FBallisticTable>> Tables;
+	/// How long building all the tables took, in seconds.
+	double BuildSeconds = 0;
+};
@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatLogSubsystem.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<int32> CVarCombatLogWriteFile(
+	TEXT("ToonTanks.CombatLog.WriteFile"),
+	1,
+	TEXT("Write the combat log to Saved/Logs/CombatLog-<date>-<world>-<pid>-<n>.bin from a background thread. Read when a World starts."));
+
+/// Type "ToonTanks.CombatLog.Dump 50" in the console to see the last 50 hits and deaths.
+static FAutoConsoleCommandWithWorldAndArgs CombatLogDumpCommand(
+	TEXT("ToonTanks.CombatLog.Dump"),
+	TEXT("Print the newest combat log entries for the current world. Optional argument: how many (default 32)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UCombatLogSubsystem* CombatLog = World ? World->GetSubsystem<UCombatLogSubsystem>() : nullptr) {
+			CombatLog->DumpTail(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 32);
+		}
+	}));
+
+/// How often the writer thread wakes up on its own, in milliseconds.
+static constexpr uint32 CombatLogDrainIntervalMs = 250;
+static constexpr uint32 CombatLogFileVersion = 1;
+
+// -------------------------------------------------------------------------------------------
+bool FCombatLogRing::Push(const FCombatLogRecord& Record)
+{
+	const uint64 CurrentHead = Head.load(std::memory_order_relaxed);
+	if (CurrentHead - Tail.load(std::memory_order_acquire) >= Capacity) {
+		if (HasReader.load(std::memory_order_acquire)) {
+			Dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		// Nobody's going to drain it, so forget the oldest record to make room.
+		Tail.store(CurrentHead - Capacity + 1, std::memory_order_relaxed);
+	}
+
+	Records[CurrentHead & (Capacity - 1)] = Record;
+	// Release, so the reader sees the record before it sees the new Head.
+	Head.store(CurrentHead + 1, std::memory_order_release);
+	return true;
+}
+
+// -------------------------------------------------------------------------------------------
+int32 FCombatLogRing::Pop(TArray<FCombatLogRecord>& Out)
+{
+	const uint64 CurrentTail = Tail.load(std::memory_order_relaxed);
+	const uint64 CurrentHead = Head.load(std::memory_order_acquire);
+	const int32 Num = static_cast<int32>(CurrentHead - CurrentTail);
+
+	Out.Reset(Num);
+	for (uint64 Index = CurrentTail; Index < CurrentHead; Index++) {
+		Out.Add(Records[Index & (Capacity - 1)]);
+	}
+	// Release, so the writer doesn't reuse the slots until we're done copying them.
+	Tail.store(CurrentHead, std::memory_order_release);
+	return Num;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Slots only ever get written by the game thread, so reading them from there is always safe.
+void FCombatLogRing::CopyTail(int32 Count, TArray<FCombatLogRecord>& Out) const
+{
+	const uint64 CurrentHead = Head.load(std::memory_order_relaxed);
+	const uint64 Available = FMath::Min<uint64>(CurrentHead, Capacity);
+	const uint64 Num = FMath::Min<uint64>(FMath::Max(Count, 0), Available);
+
+	Out.Reset(Num);
+	for (uint64 Index = CurrentHead - Num; Index < CurrentHead; Index++) {
+		Out.Add(Records[Index & (Capacity - 1)]);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+FCombatLogWriter::FCombatLogWriter(FCombatLogRing& InRing, const FString& InFilePath)
+	: Ring(InRing), FilePath(InFilePath)
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Scratch.Reserve(FCombatLogRing::Capacity);
+}
+
+// -------------------------------------------------------------------------------------------
+FCombatLogWriter::~FCombatLogWriter()
+{
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Wake up every so often (or when kicked), write out whatever's in the ring, repeat until stopped.
+uint32 FCombatLogWriter::Run()
+{
+	File = IFileManager::Get().CreateFileWriter(*FilePath);
+	if (!File) {
+		UE_LOG(LogTemp, Warning, TEXT("Combat log: couldn't open %s, keeping the log in memory only."), *FilePath);
+		Ring.SetHasReader(false);
+		return 1;
+	}
+
+	// "TTCL" in little endian.
+	uint32 Magic = 0x4C435454;
+	uint32 Version = CombatLogFileVersion;
+	*File << Magic << Version;
+
+	while (!IsStopping.load(std::memory_order_relaxed)) {
+		WakeEvent->Wait(CombatLogDrainIntervalMs);
+		Drain();
+	}
+
+	// Whatever came in after the last drain.
+	Drain();
+	File->Close();
+	delete File;
+	File = nullptr;
+	return 0;
+}
+
+// -------------------------------------------------------------------------------------------
+void FCombatLogWriter::Stop()
+{
+	IsStopping.store(true, std::memory_order_relaxed);
+	WakeEvent->Trigger();
+}
+
+// -------------------------------------------------------------------------------------------
+void FCombatLogWriter::Kick()
+{
+	WakeEvent->Trigger();
+}
+
+// -------------------------------------------------------------------------------------------
+void FCombatLogWriter::Drain()
+{
+	if (Ring.Pop(Scratch) == 0) {
+		return;
+	}
+
+	// Look up (or write out) the file index for Name.
+	auto GetNameIndex = [this](FName Name)
+	{
+		if (const uint32* Found = NameIndices.Find(Name)) {
+			return *Found;
+		}
+		uint32 Index = NameIndices.Num();
+		NameIndices.Add(Name, Index);
+
+		uint8 Tag = 'N';
+		FString NameString = Name.ToString();
+		*File << Tag << Index << NameString;
+		return Index;
+	};
+
+	for (FCombatLogRecord& Record : Scratch) {
+		uint32 Victim = GetNameIndex(Record.Victim);
+		uint32 Instigator = GetNameIndex(Record.Instigator);
+
+		uint8 Tag = 'E';
+		uint8 Event = static_cast<uint8>(Record.Event);
+		*File << Tag << Event << Record.Time << Record.Damage << Record.HealthRemaining << Victim << Instigator;
+	}
+	File->Flush();
+}
+
+// -------------------------------------------------------------------------------------------
+void UCombatLogSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Ring = MakeUnique<FCombatLogRing>();
+
+	// Only real games write a file, editor preview worlds and the like don't need one.
+	UWorld* World = GetWorld();
+	const bool IsGameWorld = World && World->IsGameWorld();
+	if (!IsGameWorld || !CVarCombatLogWriteFile.GetValueOnGameThread() || !FPlatformProcess::SupportsMultithreading()) {
+		return;
+	}
+
+	// The date only goes down to the second, so PIE with several clients (or a quick restart) would share it.
+	// World name, process id and a per-process count keep every World's file its own.
+	static int32 NumFilesOpened = 0;
+	const FString FileName = FString::Printf(TEXT("CombatLog-%s-%s-%u-%d.bin"),
+		*FDateTime::Now().ToString(), *World->GetName(), FPlatformProcess::GetCurrentProcessId(), NumFilesOpened++);
+	Writer = MakeUnique<FCombatLogWriter>(*Ring, FPaths::Combine(FPaths::ProjectLogDir(), FileName));
+	Ring->SetHasReader(true);
+	WriterThread = FRunnableThread::Create(Writer.Get(), TEXT("ToonTanksCombatLog"), 0, TPri_BelowNormal);
+	if (!WriterThread) {
+		Ring->SetHasReader(false);
+		Writer.Reset();
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Let the writer thread finish the file before the ring it reads from goes away.
+void UCombatLogSubsystem::Deinitialize()
+{
+	if (WriterThread) {
+		WriterThread->Kill(true);
+		delete WriterThread;
+		WriterThread = nullptr;
+	}
+	Writer.Reset();
+	Ring.Reset();
+
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void UCombatLogSubsystem::LogDamage(const AActor* Victim, const AActor* Instigator, float Damage, float HealthRemaining)
+{
+	Log(ECombatLogEvent::Damage, Victim, Instigator, Damage, HealthRemaining);
+}
+
+// -------------------------------------------------------------------------------------------
+void UCombatLogSubsystem::LogDeath(const AActor* Victim, const AActor* Instigator)
+{
+	Log(ECombatLogEvent::Death, Victim, Instigator, 0, 0);
+}
+
+// -------------------------------------------------------------------------------------------
+void UCombatLogSubsystem::Log(ECombatLogEvent Event, const AActor* Victim, const AActor* Instigator,
+	float Damage, float HealthRemaining)
+{
+	if (!Ring) {
+		return;
+	}
+
+	FCombatLogRecord Record;
+	Record.Time = GetWorld()->GetTimeSeconds();
+	Record.Damage = Damage;
+	Record.HealthRemaining = HealthRemaining;
+	Record.Victim = Victim ? Victim->GetFName() : NAME_None;
+	Record.Instigator = Instigator ? Instigator->GetFName() : NAME_None;
+	Record.Event = Event;
+	Ring->Push(Record);
+
+	// A big fight can fill the ring faster than the timer drains it, so kick the writer every half a ring.
+	if (Writer && Ring->GetNumWritten() % (FCombatLogRing::Capacity / 2) == 0) {
+		Writer->Kick();
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UCombatLogSubsystem::DumpTail(int32 Count) const
+{
+	if (!Ring) {
+		return;
+	}
+
+	TArray<FCombatLogRecord> Records;
+	Ring->CopyTail(Count, Records);
+
+	UE_LOG(LogTemp, Display, TEXT("Combat log: %llu recorded, %llu dropped, newest %d:"),
+		Ring->GetNumWritten(), Ring->GetNumDropped(), Records.Num());
+
+	for (const FCombatLogRecord& Record : Records) {
+		if (Record.Event == ECombatLogEvent::Death) {
+			UE_LOG(LogTemp, Display, TEXT("  [%8.2f] %s killed by %s"),
+				Record.Time, *Record.Victim.ToString(), *Record.Instigator.ToString());
+		}
+		else {
+			UE_LOG(LogTemp, Display, TEXT("  [%8.2f] %s took %.1f from %s, %.1f left"),
+				Record.Time, *Record.Victim.ToString(), Record.Damage, *Record.Instigator.ToString(),
+				Record.HealthRemaining);
+		}
+	}
+}
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include <atomic>
+
+#include "CombatLogSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class FArchive;
+class FRunnableThread;
+class UCombatLogSubsystem;
+
+// -------------------------------------------------------------------------------------------
+enum class ECombatLogEvent : uint8
+{
+	Damage,
+	Death,
+};
+
+// -------------------------------------------------------------------------------------------
+/// One combat log entry. Plain data only, so logging one is a copy and nothing else.
+struct FCombatLogRecord
+{
+	/// World time in seconds.
+	float Time;
+	float Damage;
+	float HealthRemaining;
+	FName Victim;
+	FName Instigator;
+	ECombatLogEvent Event;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Fixed size ring of FCombatLogRecords, with one writer (the game thread) and one reader (the drain thread). \n
+ * No locks: the writer only moves Head and the reader only moves Tail. When the reader falls a whole
+ * ring behind, new records get dropped (and counted) instead of overwriting ones it hasn't read yet. \n
+ * Without a reader (no file being written) the ring is just the history for the dump, so then the
+ * writer moves Tail too, and new records overwrite the oldest.
+ */
+class FCombatLogRing
+{
+public:
+	static constexpr uint32 Capacity = 4096;
+
+	/// Game thread only.
+	bool Push(const FCombatLogRecord& Record);
+	/// Drain thread only. Copies everything written so far to Out, returns how many.
+	int32 Pop(TArray<FCombatLogRecord>& Out);
+	/// Game thread only. Up to Count of the newest records, oldest first, whether drained or not.
+	void CopyTail(int32 Count, TArray<FCombatLogRecord>& Out) const;
+
+	/// Set before the drain thread starts, and cleared if it gives up (like when the file won't open).
+	void SetHasReader(bool Value) { HasReader.store(Value, std::memory_order_release); }
+
+	uint64 GetNumWritten() const { return Head.load(std::memory_order_relaxed); }
+	uint64 GetNumDropped() const { return Dropped.load(std::memory_order_relaxed); }
+
+private:
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+	FCombatLogRecord Records[Capacity];
+	std::atomic<uint64> Head{0};
+	std::atomic<uint64> Tail{0};
+	std::atomic<uint64> Dropped{0};
+	std::atomic<bool> HasReader{false};
+};
+
+// -------------------------------------------------------------------------------------------
+/// Background thread that empties the ring into a binary file every so often.
+class FCombatLogWriter : public FRunnable
+{
+public:
+	FCombatLogWriter(FCombatLogRing& InRing, const FString& InFilePath);
+	virtual ~FCombatLogWriter() override;
+
+	// FRunnable interface.
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	/// Wake the thread up early (the ring is filling up).
+	void Kick();
+
+private:
+	void Drain();
+
+	FCombatLogRing& Ring;
+	FString FilePath;
+	FArchive* File = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> IsStopping{false};
+
+	/// Names get written to the file once, then records refer to them by index.
+	TMap<FName, uint32> NameIndices;
+	TArray<FCombatLogRecord> Scratch;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Binary combat log. Damage and deaths get recorded as plain structs into a ring buffer,
+ * with no string formatting or log devices on the game thread. A background thread writes them to
+ * Saved/Logs/CombatLog-<date>-<world>-<pid>-<n>.bin (when ToonTanks.CombatLog.WriteFile is on), and
+ * "ToonTanks.CombatLog.Dump [Count]" prints the newest entries as text.
+ *
+ * File layout, little endian, after a 4 byte 'TTCL' magic and a uint32 version:
+ *   uint8 'N', uint32 Index, FString Name           (first time a name shows up)
+ *   uint8 'E', uint8 Event, float Time, float Damage, float HealthRemaining, uint32 Victim, uint32 Instigator
+ */
+UCLASS()
+class TOONTANKS_API UCombatLogSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// ---------------------------------------------------------
+	void LogDamage(const AActor* Victim, const AActor* Instigator, float Damage, float HealthRemaining);
+	void LogDeath(const AActor* Victim, const AActor* Instigator);
+
+	/// Print the newest Count entries to the output log.
+	void DumpTail(int32 Count) const;
+
+private:
+	// ---------------------------------------------------------
+	void Log(ECombatLogEvent Event, const AActor* Victim, const AActor* Instigator, float Damage, float HealthRemaining);
+
+	TUniquePtr<FCombatLogRing> Ring;
+	TUniquePtr<FCombatLogWriter> Writer;
+	FRunnableThread* WriterThread = nullptr;
+};
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DamageSubsystem.h"
+
+#include "Engine/World.h"
+#include "ToonTanks/Components/HealthComponent.h"
+#include "ToonTanks/GameModes/TankGameModeBase.h"
+#include "ToonTanks/Subsystems/CombatLogSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.Damage.Stats" in the console to see how much damage is going through, and how little of it reaches Blueprints.
+static FAutoConsoleCommandWithWorld DamageStatsCommand(
+	TEXT("ToonTanks.Damage.Stats"),
+	TEXT("Print how many health components are registered, and how many hits and health transitions there have been."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UDamageSubsystem* Damage = World ? World->GetSubsystem<UDamageSubsystem>() : nullptr) {
+			Damage->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+/// One hit that actually changed someone's health, kept between the passes of ApplyDamageBatch().
+struct FAppliedDamage
+{
+	UHealthComponent* Component;
+	float PreviousHealth;
+	float Health;
+	const AActor* Instigator;
+	/// Crossed the component's next threshold, died, or healed back over one.
+	bool IsTransition;
+};
+
+// -------------------------------------------------------------------------------------------
+void UDamageSubsystem::Deinitialize()
+{
+	Healths.Empty();
+	MaxHealths.Empty();
+	NextTransitions.Empty();
+	Components.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void UDamageSubsystem::RegisterHealth(UHealthComponent* Component, float MaxHealth)
+{
+	if (!Component || Component->HealthHandle != INDEX_NONE) {
+		return;
+	}
+
+	Component->HealthHandle = Components.Add(Component);
+	Healths.Add(MaxHealth);
+	MaxHealths.Add(MaxHealth);
+	NextTransitions.Add(Component->FindNextThreshold(MaxHealth));
+}
+
+// -------------------------------------------------------------------------------------------
+/// Swap the last component into our slot, so the arrays stay packed.
+void UDamageSubsystem::UnregisterHealth(UHealthComponent* Component)
+{
+	if (!Component || !Components.IsValidIndex(Component->HealthHandle) || Components[Component->HealthHandle] != Component) {
+		return;
+	}
+
+	const int32 Handle = Component->HealthHandle;
+	Components.RemoveAtSwap(Handle, 1, false);
+	Healths.RemoveAtSwap(Handle, 1, false);
+	MaxHealths.RemoveAtSwap(Handle, 1, false);
+	NextTransitions.RemoveAtSwap(Handle, 1, false);
+	if (Components.IsValidIndex(Handle) && Components[Handle]) {
+		Components[Handle]->HealthHandle = Handle;
+	}
+	Component->HealthHandle = INDEX_NONE;
+}
+
+// -------------------------------------------------------------------------------------------
+void UDamageSubsystem::ApplyDamage(int32 Handle, float Damage, const AActor* Instigator)
+{
+	const FDamageRequest Request = {Handle, Damage, Instigator};
+	ApplyDamageBatch(MakeArrayView(&Request, 1));
+}
+
+// -------------------------------------------------------------------------------------------
+/// Health first, then the per-hit bookkeeping, then the transitions. The transitions go last
+/// since a death can destroy the owner, which unregisters it and moves someone else's handle.
+void UDamageSubsystem::ApplyDamageBatch(TArrayView<const FDamageRequest> Requests)
+{
+	TOONTANKS_SCOPE_CYCLE(TakeDamage);
+	TOONTANKS_COUNT(DamageEvents, Requests.Num());
+	NumRequests += Requests.Num();
+	NumBatches++;
+
+	TArray<FAppliedDamage, TInlineAllocator<16>> Applied;
+	for (const FDamageRequest& Request : Requests) {
+		// If 0 damage was taken, or if target is already dead, we don't need to do anything below.
+		if (!Healths.IsValidIndex(Request.Handle) || Request.Damage == 0 || Healths[Request.Handle] <= 0) {
+			continue;
+		}
+
+		// Clamp here ensures we can't have negative health, or more health than the max.
+		const float PreviousHealth = Healths[Request.Handle];
+		const float Health = FMath::Clamp(PreviousHealth - Request.Damage, 0.f, MaxHealths[Request.Handle]);
+		if (Health == PreviousHealth) {
+			continue;
+		}
+		Healths[Request.Handle] = Health;
+
+		const bool IsTransition = Health <= NextTransitions[Request.Handle] || Health > PreviousHealth;
+		Applied.Add({Components[Request.Handle], PreviousHealth, Health, Request.Instigator, IsTransition});
+	}
+	if (Applied.Num() == 0) {
+		return;
+	}
+
+	// No UE_LOG here, this happens on every hit. See "ToonTanks.CombatLog.Dump" instead.
+	UCombatLogSubsystem* CombatLog = GetWorld()->GetSubsystem<UCombatLogSubsystem>();
+	// Let the GameMode keep score (damage dealt/taken) if it cares.
+	ATankGameModeBase* GameMode = GetWorld()->GetAuthGameMode<ATankGameModeBase>();
+	for (const FAppliedDamage& Entry : Applied) {
+		AActor* Owner = Entry.Component->GetOwner();
+		if (CombatLog) {
+			CombatLog->LogDamage(Owner, Entry.Instigator, Entry.PreviousHealth - Entry.Health, Entry.Health);
+		}
+		if (GameMode) {
+			GameMode->ActorDamaged(Owner, Entry.PreviousHealth - Entry.Health);
+		}
+	}
+
+	for (const FAppliedDamage& Entry : Applied) {
+		if (!Entry.IsTransition || !IsValid(Entry.Component)) {
+			continue;
+		}
+		NumTransitions++;
+		// Re-arm before telling the component, in case it's gone by the time HandleHealthChange() returns.
+		const int32 Handle = Entry.Component->HealthHandle;
+		if (NextTransitions.IsValidIndex(Handle)) {
+			NextTransitions[Handle] = Entry.Component->FindNextThreshold(Healths[Handle]);
+		}
+		Entry.Component->HandleHealthChange(Entry.PreviousHealth, Entry.Health, Entry.Instigator);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UDamageSubsystem::LogStats() const
+{
+	int32 NumDead = 0;
+	for (const float Health : Healths) {
+		NumDead += Health <= 0 ? 1 : 0;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Damage: %d health components (%d dead), %d hits in %d batches, %d transitions."),
+		Components.Num(), NumDead, NumRequests, NumBatches, NumTransitions);
+}
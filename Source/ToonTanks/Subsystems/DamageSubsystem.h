@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "DamageSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class UHealthComponent;
+
+// -------------------------------------------------------------------------------------------
+/// One hit (or a pawn's whole share of a batch of splash damage). Negative Damage heals.
+struct FDamageRequest
+{
+	/// The victim's UHealthComponent::GetHealthHandle().
+	int32 Handle;
+	float Damage;
+	/// Who gets the credit (and the kill). Can be null.
+	const AActor* Instigator;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Holds the health of every UHealthComponent in the World in one dense array, indexed by the
+ * component's handle, and applies damage to it with plain native calls. \n
+ * A batch of damage is applied in three passes: first every health value is updated in the dense arrays
+ * (no components or actors touched), then each hit is reported to the combat log and the GameMode,
+ * and last, only the components whose health crossed one of their thresholds (or hit 0) are told,
+ * which is where their Blueprint events and death handling happen. \n
+ * Pawns override TakeDamage() to come straight here, so engine damage (UGameplayStatics::ApplyDamage)
+ * never goes through the OnTakeAnyDamage dynamic delegate.
+ */
+UCLASS()
+class TOONTANKS_API UDamageSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Deinitialize() override;
+
+	/// Called by health components in BeginPlay. Sets the component's handle.
+	void RegisterHealth(UHealthComponent* Component, float MaxHealth);
+	/// Called by health components in EndPlay. The last component takes over the freed handle.
+	void UnregisterHealth(UHealthComponent* Component);
+
+	void ApplyDamage(int32 Handle, float Damage, const AActor* Instigator);
+	void ApplyDamageBatch(TArrayView<const FDamageRequest> Requests);
+
+	float GetHealth(int32 Handle) const { return Healths.IsValidIndex(Handle) ? Healths[Handle] : 0; }
+	float GetMaxHealth(int32 Handle) const { return MaxHealths.IsValidIndex(Handle) ? MaxHealths[Handle] : 0; }
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	// All four line up by handle.
+	TArray<float> Healths;
+	TArray<float> MaxHealths;
+	/// The health at or below which the component next needs telling (its next threshold down, or 0 for death).
+	TArray<float> NextTransitions;
+	UPROPERTY()
+	TArray<UHealthComponent*> Components;
+
+	// Totals since the World started.
+	int32 NumRequests = 0;
+	int32 NumBatches = 0;
+	int32 NumTransitions = 0;
+};
@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EffectsSubsystem.h"
+
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/Engine.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "ToonTanks/Subsystems/SignificanceSubsystem.h"
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<float> CVarEffectsMaxDistance(
+	TEXT("ToonTanks.Effects.MaxDistance"),
+	10000.f,
+	TEXT("Effects further than this from the camera are not spawned."));
+
+static TAutoConsoleVariable<float> CVarEffectsMergeRadius(
+	TEXT("ToonTanks.Effects.MergeRadius"),
+	150.f,
+	TEXT("An effect this close to the same effect spawned within MergeWindow is skipped."));
+
+static TAutoConsoleVariable<float> CVarEffectsMergeWindow(
+	TEXT("ToonTanks.Effects.MergeWindow"),
+	0.1f,
+	TEXT("Seconds during which effects on top of each other are merged."));
+
+static TAutoConsoleVariable<int32> CVarEffectsMaxPooled(
+	TEXT("ToonTanks.Effects.MaxPooledPerTemplate"),
+	32,
+	TEXT("Finished components kept around per particle template. Extra ones are destroyed."));
+
+/// Type "ToonTanks.Effects.Stats" in the console to see how many effects got culled.
+static FAutoConsoleCommandWithWorld EffectsStatsCommand(
+	TEXT("ToonTanks.Effects.Stats"),
+	TEXT("Print how many effects were spawned, reused, culled and merged."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UEffectsSubsystem* Effects = World ? World->GetSubsystem<UEffectsSubsystem>() : nullptr) {
+			Effects->LogStats();
+		}
+	}));
+
+/// Effects this close to the camera are always spawned, even if their center is just off screen.
+static constexpr float AlwaysVisibleDistance = 1000;
+/// Extra degrees on top of half the FOV, so big effects just off screen still show their edges.
+static constexpr float FrustumMarginDegrees = 10;
+
+// -------------------------------------------------------------------------------------------
+void UEffectsSubsystem::Deinitialize()
+{
+	for (TPair<UParticleSystem*, FEffectPool>& Pair : Pools) {
+		for (UParticleSystemComponent* Effect : Pair.Value.Free) {
+			if (Effect) {
+				Effect->DestroyComponent();
+			}
+		}
+	}
+	Pools.Empty();
+	RecentEffects.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Same idea as UGameplayStatics::SpawnEmitterAtLocation(), but culled, merged and pooled.
+UParticleSystemComponent* UEffectsSubsystem::SpawnEffect(UParticleSystem* Template, const FVector& Location,
+	const FRotator& Rotation)
+{
+	if (!Template) {
+		return nullptr;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (ShouldCull(Location)) {
+		NumCulled++;
+		return nullptr;
+	}
+	if (ShouldMerge(Template, Location, Now)) {
+		NumMerged++;
+		return nullptr;
+	}
+	RecentEffects.Add({Template, Location, Now});
+
+	UParticleSystemComponent* Effect = nullptr;
+	FEffectPool& Pool = Pools.FindOrAdd(Template);
+	while (Pool.Free.Num() > 0 && !Effect) {
+		UParticleSystemComponent* Candidate = Pool.Free.Pop(false);
+		if (IsValid(Candidate)) {
+			Effect = Candidate;
+		}
+	}
+
+	if (Effect) {
+		NumReused++;
+	}
+	else {
+		NumSpawned++;
+		Effect = CreateEffectComponent(Template);
+	}
+
+	Effect->SetWorldLocationAndRotation(Location, Rotation);
+	Effect->Activate(true);
+	return Effect;
+}
+
+// -------------------------------------------------------------------------------------------
+void UEffectsSubsystem::LogStats() const
+{
+	UE_LOG(LogTemp, Display, TEXT("Effects: %d spawned, %d reused, %d culled, %d merged."),
+		NumSpawned, NumReused, NumCulled, NumMerged);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Skip effects nobody can see: no rendering at all, too far from the camera, or behind it.
+bool UEffectsSubsystem::ShouldCull(const FVector& Location)
+{
+	// Headless runs (-nullrhi, dedicated servers) never draw anything.
+	if (!FApp::CanEverRender()) {
+		return true;
+	}
+	// Low and Dormant significance battles don't get particles.
+	USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	if (Significance && !Significance->ShouldSpawnEffect(Location)) {
+		return true;
+	}
+
+	// The local player, not just the first one (on a listen server that could be a remote player's).
+	APlayerController* PlayerController = GEngine->GetFirstLocalPlayerController(GetWorld());
+	APlayerCameraManager* Camera = PlayerController ? PlayerController->PlayerCameraManager : nullptr;
+	if (!Camera) {
+		return false;
+	}
+
+	const FVector ToEffect = Location - Camera->GetCameraLocation();
+	const float DistanceSquared = ToEffect.SizeSquared();
+	if (DistanceSquared > FMath::Square(CVarEffectsMaxDistance.GetValueOnGameThread())) {
+		return true;
+	}
+	if (DistanceSquared < FMath::Square(AlwaysVisibleDistance)) {
+		return false;
+	}
+
+	// Compare the angle to the effect against half the (horizontal) FOV, which is the widest part of the view.
+	const float HalfFOV = FMath::Min(Camera->GetFOVAngle() * 0.5f + FrustumMarginDegrees, 89.f);
+	const float CosHalfFOV = FMath::Cos(FMath::DegreesToRadians(HalfFOV));
+	const FVector Forward = Camera->GetCameraRotation().Vector();
+	return FVector::DotProduct(ToEffect.GetUnsafeNormal(), Forward) < CosHalfFOV;
+}
+
+// -------------------------------------------------------------------------------------------
+/// True if the same effect just spawned close enough that a second one wouldn't look any different.
+bool UEffectsSubsystem::ShouldMerge(UParticleSystem* Template, const FVector& Location, float Now)
+{
+	const float MergeWindow = CVarEffectsMergeWindow.GetValueOnGameThread();
+	const float MergeRadiusSquared = FMath::Square(CVarEffectsMergeRadius.GetValueOnGameThread());
+
+	RecentEffects.RemoveAllSwap([Now, MergeWindow](const FRecentEffect& Recent) { return Now - Recent.Time > MergeWindow; }, false);
+
+	return RecentEffects.ContainsByPredicate([&](const FRecentEffect& Recent)
+	{
+		return Recent.Template == Template && FVector::DistSquared(Recent.Location, Location) <= MergeRadiusSquared;
+	});
+}
+
+// -------------------------------------------------------------------------------------------
+/// Mostly what SpawnEmitterAtLocation() does, except the component sticks around when it finishes.
+UParticleSystemComponent* UEffectsSubsystem::CreateEffectComponent(UParticleSystem* Template)
+{
+	UParticleSystemComponent* Effect = NewObject<UParticleSystemComponent>(GetWorld());
+	Effect->bAutoDestroy = false;
+	Effect->bAutoActivate = false;
+	Effect->SecondsBeforeInactive = 0;
+	Effect->SetTemplate(Template);
+	Effect->SetAbsolute(true, true, true);
+	Effect->OnSystemFinished.AddDynamic(this, &UEffectsSubsystem::OnEffectFinished);
+	Effect->RegisterComponentWithWorld(GetWorld());
+	return Effect;
+}
+
+// -------------------------------------------------------------------------------------------
+void UEffectsSubsystem::OnEffectFinished(UParticleSystemComponent* Effect)
+{
+	if (!Effect || !Effect->Template) {
+		return;
+	}
+
+	FEffectPool& Pool = Pools.FindOrAdd(Effect->Template);
+	if (Pool.Free.Num() >= CVarEffectsMaxPooled.GetValueOnGameThread()) {
+		Effect->DestroyComponent();
+		return;
+	}
+	Pool.Free.Push(Effect);
+}
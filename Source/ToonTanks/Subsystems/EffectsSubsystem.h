@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "EffectsSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class UParticleSystem;
+class UParticleSystemComponent;
+
+// -------------------------------------------------------------------------------------------
+/// Finished particle components for one template, waiting to be used again.
+USTRUCT()
+struct FEffectPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<UParticleSystemComponent*> Free;
+};
+
+// -------------------------------------------------------------------------------------------
+/// An effect we spawned recently, so another one right on top of it can be skipped.
+struct FRecentEffect
+{
+	UParticleSystem* Template;
+	FVector Location;
+	float Time;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Every gameplay particle effect goes through here instead of SpawnEmitterAtLocation(). \n
+ * Effects that are too far away or behind the camera are skipped, effects landing on top of
+ * one that just spawned are merged into it, and finished particle components go back into
+ * a per-template pool instead of being destroyed.
+ */
+UCLASS()
+class TOONTANKS_API UEffectsSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Deinitialize() override;
+
+	/// Play Template at Location. Returns nullptr if the effect was culled or merged.
+	UParticleSystemComponent* SpawnEffect(
+		UParticleSystem* Template,
+		const FVector& Location,
+		const FRotator& Rotation = FRotator::ZeroRotator
+		);
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	bool ShouldCull(const FVector& Location);
+	bool ShouldMerge(UParticleSystem* Template, const FVector& Location, float Now);
+	UParticleSystemComponent* CreateEffectComponent(UParticleSystem* Template);
+
+	/// Bound to every pooled component's OnSystemFinished, puts it back in its pool.
+	UFUNCTION()
+	void OnEffectFinished(UParticleSystemComponent* Effect);
+
+	UPROPERTY()
+	TMap<UParticleSystem*, FEffectPool> Pools;
+	TArray<FRecentEffect> RecentEffects;
+
+	int32 NumSpawned = 0;
+	int32 NumReused = 0;
+	int32 NumCulled = 0;
+	int32 NumMerged = 0;
+};
@@ -0,0 +1,376 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ExplosionSubsystem.h"
+
+#include "Components/StaticMeshComponent.h"
+#include "Misc/MemStack.h"
+#include "ToonTanks/Components/HealthComponent.h"
+#include "ToonTanks/Subsystems/DamageSubsystem.h"
+#include "ToonTanks/Pawns/PawnBase.h"
+#include "ToonTanks/Subsystems/SceneQuerySubsystem.h"
+#include "ToonTanks/Subsystems/SignificanceSubsystem.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/Subsystems/WeaponDefinitionSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<float> CVarExplosionClusterDistance(
+	TEXT("ToonTanks.Explosions.ClusterDistance"),
+	500.f,
+	TEXT("Explosions closer than this to the first explosion of a cluster share one overlap query."));
+
+/// Low significance explosions cluster this many times further apart, since they're approximated anyway.
+static constexpr float ApproximateClusterScale = 4;
+
+// -------------------------------------------------------------------------------------------
+/// A group of explosions that share one overlap query.
+struct FExplosionCluster
+{
+	FVector Seed;
+	/// Everything any explosion in the cluster reaches, pushing or splashing.
+	FBox Bounds;
+	/// Just what the pushes reach.
+	FBox PushBounds;
+	/// Low significance: every body gets one push from the middle of the cluster, instead of one per explosion.
+	bool Approximate;
+	FVector LocationSum;
+	float ForceSum;
+	int32 NumExplosions;
+};
+
+// -------------------------------------------------------------------------------------------
+/// What we've pushed a body with so far in one batch of explosions.
+struct FBodyImpulse
+{
+	FVector VelocityChange = FVector::ZeroVector;
+	/// Last cluster that touched this body, so a body overlapped twice by one query only counts once.
+	int32 LastCluster = INDEX_NONE;
+};
+
+// -------------------------------------------------------------------------------------------
+/// The splash damage one pawn has taken so far in one batch of explosions.
+struct FSplashVictim
+{
+	float Damage = 0;
+	/// Last cluster that reached this pawn, so a pawn overlapped twice (capsule and meshes) by one query only counts once.
+	int32 LastCluster = INDEX_NONE;
+	/// Whoever did the most damage gets the credit for all of it (and the kill).
+	TWeakObjectPtr<AActor> Instigator;
+	float LargestShare = 0;
+};
+
+// -------------------------------------------------------------------------------------------
+/// One frame's explosions, waiting on their clusters' overlaps to come back.
+struct FExplosionBatch
+{
+	TArray<FQueuedExplosion> Explosions;
+	TArray<int32> ClusterOfExplosion;
+	/// Per cluster: a single explosion standing in for all of an approximated cluster's (Radius 0 for exact clusters).
+	TArray<FQueuedExplosion> Approximations;
+	TMap<UStaticMeshComponent*, FBodyImpulse> Impulses;
+	TMap<APawnBase*, FSplashVictim> Victims;
+	TWeakObjectPtr<UDamageSubsystem> DamageSubsystem;
+	int32 ClustersLeft = 0;
+};
+
+// -------------------------------------------------------------------------------------------
+void UExplosionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// With a fixed timestep, resolve each step's explosions at the end of that step, so the damage
+	// and pushes land in the same step no matter how many steps a frame runs.
+	USimulationClockSubsystem* SimulationClock = Cast<USimulationClockSubsystem>(
+		Collection.InitializeDependency(USimulationClockSubsystem::StaticClass()));
+	if (SimulationClock && SimulationClock->IsFixedStep()) {
+		IsFixedStep = true;
+		SimulationClock->OnPostStep.AddWeakLambda(this, [this](float StepSeconds)
+		{
+			if (PendingExplosions.Num() > 0) {
+				ResolveExplosions();
+			}
+		});
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UExplosionSubsystem::Deinitialize()
+{
+	PendingExplosions.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void UExplosionSubsystem::Tick(float DeltaTime)
+{
+	ResolveExplosions();
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType UExplosionSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+bool UExplosionSubsystem::IsTickable() const
+{
+	return PendingExplosions.Num() > 0 && !IsFixedStep;
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* UExplosionSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId UExplosionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UExplosionSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Far from every player (see USignificanceSubsystem), Low explosions get their pushes approximated and Dormant ones
+/// don't push anything. Splash damage is gameplay though, so it's always done properly.
+void UExplosionSubsystem::QueueExplosion(const FVector& Location, float Radius, float Force, const FSplashDamage& Splash)
+{
+	const USignificanceSubsystem* Significance = GetWorld()->GetSubsystem<USignificanceSubsystem>();
+	const ESignificanceTier Tier = Significance ? Significance->GetTierAt(Location) : ESignificanceTier::High;
+	// Nobody is close enough to see a Dormant explosion push anything around.
+	const bool PushBodies = Tier != ESignificanceTier::Dormant;
+	if (!PushBodies) {
+		TOONTANKS_COUNT(ExplosionsSkipped, 1);
+		if (Splash.Damage <= 0) {
+			return;
+		}
+	}
+	if (Tier == ESignificanceTier::Low) {
+		TOONTANKS_COUNT(ExplosionsApproximated, 1);
+	}
+	PendingExplosions.Add({Location, Radius, Force, Tier == ESignificanceTier::Low, PushBodies, Splash});
+}
+
+// -------------------------------------------------------------------------------------------
+/// No splash radius in the weapon table means the splash reaches as far as the push.
+void UExplosionSubsystem::QueueWeaponExplosion(const FVector& Location, const FWeaponDefinition& Weapon, AActor* Instigator)
+{
+	FSplashDamage Splash;
+	Splash.Damage = Weapon.SplashDamage;
+	Splash.MinDamage = Weapon.SplashMinDamage;
+	Splash.InnerRadius = Weapon.SplashInnerRadius;
+	Splash.OuterRadius = Weapon.SplashRadius > 0 ? Weapon.SplashRadius : Weapon.ImpulseRadius;
+	Splash.Falloff = Weapon.SplashFalloff;
+	Splash.Instigator = Instigator;
+	QueueExplosion(Location, Weapon.ImpulseRadius, Weapon.ImpulseForce, Splash);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Same curve as ApplyRadialDamageWithFalloff(): full damage inside InnerRadius, down to MinDamage at OuterRadius.
+static float GetSplashDamage(const FSplashDamage& Splash, float Distance)
+{
+	if (Distance > Splash.OuterRadius) {
+		return 0;
+	}
+	if (Distance <= Splash.InnerRadius) {
+		return Splash.Damage;
+	}
+	const float Width = FMath::Max(Splash.OuterRadius - Splash.InnerRadius, KINDA_SMALL_NUMBER);
+	const float Scale = FMath::Pow(1 - (Distance - Splash.InnerRadius) / Width, Splash.Falloff);
+	return FMath::Lerp(Splash.MinDamage, Splash.Damage, Scale);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Add up the splash damage a pawn overlapped by one cluster takes from the explosions in that cluster.
+/// Like a direct hit, nobody's own explosions hurt them.
+static void AccumulateSplash(FExplosionBatch& Batch, int32 ClusterIndex, APawnBase* Pawn)
+{
+	FSplashVictim& Victim = Batch.Victims.FindOrAdd(Pawn);
+	if (Victim.LastCluster == ClusterIndex) {
+		return;
+	}
+	Victim.LastCluster = ClusterIndex;
+
+	// Distance to the edge of the pawn's collision, not its middle, so big pawns don't shrug off near misses.
+	const FBox PawnBounds = Pawn->GetRootComponent()->Bounds.GetBox();
+	for (int32 ExplosionIndex = 0; ExplosionIndex < Batch.Explosions.Num(); ExplosionIndex++) {
+		const FQueuedExplosion& Explosion = Batch.Explosions[ExplosionIndex];
+		if (Batch.ClusterOfExplosion[ExplosionIndex] != ClusterIndex || Explosion.Splash.Damage <= 0
+			|| Explosion.Splash.Instigator.Get() == Pawn) {
+			continue;
+		}
+		const float Distance = FMath::Sqrt(PawnBounds.ComputeSquaredDistanceToPoint(Explosion.Location));
+		const float Damage = GetSplashDamage(Explosion.Splash, Distance);
+		Victim.Damage += Damage;
+		if (Damage > Victim.LargestShare) {
+			Victim.LargestShare = Damage;
+			Victim.Instigator = Explosion.Splash.Instigator;
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Add up the push every body (and the splash damage every pawn) overlapped by one cluster gets from the explosions in that cluster.
+static void AccumulateCluster(FExplosionBatch& Batch, int32 ClusterIndex, const TArray<FOverlapResult>& Overlaps)
+{
+	for (const FOverlapResult& Overlap : Overlaps) {
+		AActor* Actor = Overlap.GetActor();
+		if (EnumHasAnyFlags(APawnBase::GetTagsOf(Actor), EPawnTags::Damageable)) {
+			AccumulateSplash(Batch, ClusterIndex, static_cast<APawnBase*>(Actor));
+			continue;
+		}
+
+		// Same as before: only actors with a mesh as their root get pushed around.
+		UStaticMeshComponent* Mesh = Actor ? Cast<UStaticMeshComponent>(Actor->GetRootComponent()) : nullptr;
+		if (!Mesh || !Mesh->IsSimulatingPhysics()) {
+			continue;
+		}
+
+		FBodyImpulse& Impulse = Batch.Impulses.FindOrAdd(Mesh);
+		if (Impulse.LastCluster == ClusterIndex) {
+			continue;
+		}
+		Impulse.LastCluster = ClusterIndex;
+
+		const FVector CenterOfMass = Mesh->GetCenterOfMass();
+		const FQueuedExplosion& Approximation = Batch.Approximations[ClusterIndex];
+		if (Approximation.Radius > 0) {
+			const FVector Delta = CenterOfMass - Approximation.Location;
+			if (Delta.SizeSquared() <= FMath::Square(Approximation.Radius)) {
+				Impulse.VelocityChange += Delta.GetSafeNormal() * Approximation.Force;
+			}
+			continue;
+		}
+
+		// Add up the push from every explosion in this cluster that actually reaches the body.
+		for (int32 ExplosionIndex = 0; ExplosionIndex < Batch.Explosions.Num(); ExplosionIndex++) {
+			if (Batch.ClusterOfExplosion[ExplosionIndex] != ClusterIndex) {
+				continue;
+			}
+			const FQueuedExplosion& Explosion = Batch.Explosions[ExplosionIndex];
+			const FVector Delta = CenterOfMass - Explosion.Location;
+			if (Explosion.PushBodies && Delta.SizeSquared() <= FMath::Square(Explosion.Radius)) {
+				Impulse.VelocityChange += Delta.GetSafeNormal() * Explosion.Force;
+			}
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// One impulse per body. bVelChange = true since Force is already "per unit of mass".
+static void ApplyImpulses(const FExplosionBatch& Batch)
+{
+	for (const TPair<UStaticMeshComponent*, FBodyImpulse>& Pair : Batch.Impulses) {
+		if (!Pair.Value.VelocityChange.IsNearlyZero()) {
+			Pair.Key->AddImpulse(Pair.Value.VelocityChange, NAME_None, true);
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// One batch of damage for the whole frame, one entry per pawn, straight into the UDamageSubsystem.
+static void ApplySplashDamage(const FExplosionBatch& Batch)
+{
+	UDamageSubsystem* DamageSubsystem = Batch.DamageSubsystem.Get();
+	if (!DamageSubsystem) {
+		return;
+	}
+
+	TArray<FDamageRequest, TInlineAllocator<16>> Requests;
+	for (const TPair<APawnBase*, FSplashVictim>& Pair : Batch.Victims) {
+		// The overlap came back a frame later, so the pawn might have died in between.
+		UHealthComponent* Health = IsValid(Pair.Key) ? Pair.Key->GetHealthComponent() : nullptr;
+		if (Health && Pair.Value.Damage > 0) {
+			Requests.Add({Health->GetHealthHandle(), Pair.Value.Damage, Pair.Value.Instigator.Get()});
+		}
+	}
+	DamageSubsystem->ApplyDamageBatch(Requests);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Group this frame's explosions into clusters and ask for one overlap per cluster.
+/// As each overlap comes back we add up the push every body gets, and once they're all back we apply it once per body.
+void UExplosionSubsystem::ResolveExplosions()
+{
+	TOONTANKS_SCOPE_CYCLE(ResolveExplosions);
+
+	USceneQuerySubsystem* SceneQueries = GetWorld()->GetSubsystem<USceneQuerySubsystem>();
+	if (!SceneQueries) {
+		PendingExplosions.Reset();
+		return;
+	}
+
+	// Everything allocated from the MemStack below is thrown away when Mark goes out of scope.
+	FMemMark Mark(FMemStack::Get());
+
+	const float ClusterDistanceSquared = FMath::Square(CVarExplosionClusterDistance.GetValueOnGameThread());
+	const float ApproximateDistanceSquared = ClusterDistanceSquared * FMath::Square(ApproximateClusterScale);
+
+	// The batch outlives this frame (the overlaps come back next frame), so it can't use the MemStack.
+	TSharedRef<FExplosionBatch> Batch = MakeShared<FExplosionBatch>();
+	Batch->Explosions = MoveTemp(PendingExplosions);
+	Batch->DamageSubsystem = GetWorld()->GetSubsystem<UDamageSubsystem>();
+	Batch->ClusterOfExplosion.SetNumUninitialized(Batch->Explosions.Num());
+	TArray<FExplosionCluster, TMemStackAllocator<>> Clusters;
+
+	for (int32 ExplosionIndex = 0; ExplosionIndex < Batch->Explosions.Num(); ExplosionIndex++) {
+		const FQueuedExplosion& Explosion = Batch->Explosions[ExplosionIndex];
+		const bool Approximate = Explosion.Approximate;
+		const float DistanceSquared = Approximate ? ApproximateDistanceSquared : ClusterDistanceSquared;
+
+		int32 ClusterIndex = Clusters.IndexOfByPredicate([&](const FExplosionCluster& Cluster)
+		{
+			return Cluster.Approximate == Approximate && FVector::DistSquared(Cluster.Seed, Explosion.Location) <= DistanceSquared;
+		});
+		if (ClusterIndex == INDEX_NONE) {
+			ClusterIndex = Clusters.Add({Explosion.Location, FBox(ForceInit), FBox(ForceInit), Approximate, FVector::ZeroVector, 0, 0});
+		}
+
+		FExplosionCluster& Cluster = Clusters[ClusterIndex];
+		const float PushRadius = Explosion.PushBodies ? Explosion.Radius : 0;
+		const float SplashRadius = Explosion.Splash.Damage > 0 ? Explosion.Splash.OuterRadius : 0;
+		Cluster.Bounds += FBox::BuildAABB(Explosion.Location, FVector(FMath::Max(PushRadius, SplashRadius)));
+		Cluster.PushBounds += FBox::BuildAABB(Explosion.Location, FVector(PushRadius));
+		Cluster.LocationSum += Explosion.Location;
+		Cluster.ForceSum += Explosion.Force;
+		Cluster.NumExplosions++;
+		Batch->ClusterOfExplosion[ExplosionIndex] = ClusterIndex;
+	}
+
+	// An approximated cluster is one explosion in the middle, as big as the whole cluster, with the average force.
+	Batch->Approximations.SetNumZeroed(Clusters.Num());
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ClusterIndex++) {
+		const FExplosionCluster& Cluster = Clusters[ClusterIndex];
+		if (Cluster.Approximate) {
+			Batch->Approximations[ClusterIndex] = {
+				Cluster.LocationSum / Cluster.NumExplosions,
+				Cluster.PushBounds.GetExtent().Size(),
+				Cluster.ForceSum / Cluster.NumExplosions};
+		}
+	}
+
+	Batch->ClustersLeft = Clusters.Num();
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ClusterIndex++) {
+		const FBox& Bounds = Clusters[ClusterIndex].Bounds;
+
+		TOONTANKS_COUNT(Sweeps, 1);
+		// A sphere around the cluster's bounds covers every explosion in it.
+		// Pawns block WorldStatic, so the same query finds the splash damage victims too.
+		SceneQueries->RequestOverlap(
+			Bounds.GetCenter(),
+			Bounds.GetExtent().Size(),
+			ECC_WorldStatic,
+			[Batch, ClusterIndex](const TArray<FOverlapResult>& Overlaps)
+			{
+				TOONTANKS_SCOPE_CYCLE(ResolveExplosions);
+				AccumulateCluster(*Batch, ClusterIndex, Overlaps);
+				// Every cluster's overlap comes back in the same frame, so the meshes we kept are all still around.
+				if (--Batch->ClustersLeft == 0) {
+					ApplyImpulses(*Batch);
+					ApplySplashDamage(*Batch);
+				}
+			});
+	}
+}
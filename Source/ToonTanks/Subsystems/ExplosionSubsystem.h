@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+
+#include "ExplosionSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+struct FWeaponDefinition;
+
+// -------------------------------------------------------------------------------------------
+/// Damage dealt to every damageable pawn around an explosion, same falloff as ApplyRadialDamageWithFalloff().
+struct FSplashDamage
+{
+	/// Damage inside InnerRadius. 0 means no splash damage at all.
+	float Damage = 0;
+	/// Damage at OuterRadius.
+	float MinDamage = 0;
+	float InnerRadius = 0;
+	float OuterRadius = 0;
+	/// Shape of the curve from Damage down to MinDamage: 1 is linear, higher drops off faster near the middle.
+	float Falloff = 1;
+	/// Who gets the credit (the pawn that fired), same as the damage instigator in the UDamageSubsystem.
+	TWeakObjectPtr<AActor> Instigator;
+};
+
+// -------------------------------------------------------------------------------------------
+/// One detonation waiting for the end of the frame.
+struct FQueuedExplosion
+{
+	FVector Location;
+	float Radius;
+	/// Velocity change given to every body in Radius (the old RIF_Constant impulse, scaled by mass).
+	float Force;
+	/// Low significance: clustered coarsely, and pushes from the middle of its cluster instead of from Location.
+	bool Approximate = false;
+	/// False for Dormant significance explosions, which only do their splash damage.
+	bool PushBodies = true;
+	FSplashDamage Splash;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Collects every explosion of the frame and resolves their radial impulses and splash damage together. \n
+ * Explosions close to each other are grouped into clusters, each cluster does a single overlap
+ * query, and every body gets one summed impulse no matter how many grenades went off around it.
+ * Splash damage works the same way: every pawn gets a single entry in one UDamageSubsystem batch, with the damage
+ * from every explosion that reached it, instead of one damage event per explosion. \n
+ * The overlaps go through the USceneQuerySubsystem, so (with async queries on) they run on worker threads
+ * while the game thread gets on with other work, and the impulses land at the start of the next frame. \n
+ * On a fixed timestep explosions are resolved at the end of every step instead of every frame (see USimulationClockSubsystem).
+ */
+UCLASS()
+class TOONTANKS_API UExplosionSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Queue an explosion to push physics bodies around (and splash damage pawns) at the end of this frame.
+	void QueueExplosion(const FVector& Location, float Radius, float Force, const FSplashDamage& Splash = FSplashDamage());
+	/// QueueExplosion() with Weapon's impulse and splash damage, fired by Instigator.
+	void QueueWeaponExplosion(const FVector& Location, const FWeaponDefinition& Weapon, AActor* Instigator);
+
+private:
+	// ---------------------------------------------------------
+	void ResolveExplosions();
+
+	TArray<FQueuedExplosion> PendingExplosions;
+	bool IsFixedStep = false;
+};
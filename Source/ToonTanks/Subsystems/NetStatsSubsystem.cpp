@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NetStatsSubsystem.h"
+
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "ToonTanks/ToonTanksStats.h"
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.Net.Stats" in the console to see what every connection is costing.
+static FAutoConsoleCommandWithWorld NetStatsCommand(
+	TEXT("ToonTanks.Net.Stats"),
+	TEXT("Print bandwidth, packet loss and ping for every net connection of the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UNetStatsSubsystem* NetStats = World ? World->GetSubsystem<UNetStatsSubsystem>() : nullptr) {
+			NetStats->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+/// Net connections update their byte counts once a second, we just copy the latest into the CSV profile.
+void UNetStatsSubsystem::Tick(float DeltaTime)
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+
+	int32 TotalInBytesPerSecond = 0;
+	int32 TotalOutBytesPerSecond = 0;
+	int32 MaxOutBytesPerSecond = 0;
+	int32 NumConnections = 0;
+
+	auto AddConnection = [&](const UNetConnection* Connection)
+	{
+		TotalInBytesPerSecond += Connection->InBytesPerSecond;
+		TotalOutBytesPerSecond += Connection->OutBytesPerSecond;
+		MaxOutBytesPerSecond = FMath::Max(MaxOutBytesPerSecond, Connection->OutBytesPerSecond);
+		NumConnections++;
+	};
+
+	if (NetDriver->ServerConnection) {
+		AddConnection(NetDriver->ServerConnection);
+	}
+	for (const UNetConnection* Connection : NetDriver->ClientConnections) {
+		if (Connection) {
+			AddConnection(Connection);
+		}
+	}
+
+	CSV_CUSTOM_STAT(ToonTanks, NetConnections, NumConnections, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ToonTanks, NetInBytesPerSecond, TotalInBytesPerSecond, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ToonTanks, NetOutBytesPerSecond, TotalOutBytesPerSecond, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ToonTanks, NetMaxConnectionOutBytesPerSecond, MaxOutBytesPerSecond, ECsvCustomStatOp::Set);
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType UNetStatsSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Only worth ticking when we're actually networked (listen server or client).
+bool UNetStatsSubsystem::IsTickable() const
+{
+	return GetWorld()->GetNetDriver() != nullptr;
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* UNetStatsSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId UNetStatsSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UNetStatsSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+void UNetStatsSubsystem::LogStats() const
+{
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (!NetDriver) {
+		UE_LOG(LogTemp, Display, TEXT("Net stats: not networked."));
+		return;
+	}
+
+	auto LogConnection = [](const TCHAR* Label, const UNetConnection* Connection)
+	{
+		UE_LOG(LogTemp, Display, TEXT("  %s %s: in %d B/s, out %d B/s (rate %d), lost in %d / out %d, ping %.0f ms"),
+			Label, *Connection->LowLevelGetRemoteAddress(true),
+			Connection->InBytesPerSecond, Connection->OutBytesPerSecond, Connection->CurrentNetSpeed,
+			Connection->InPacketsLost, Connection->OutPacketsLost, Connection->AvgLag * 1000);
+	};
+
+	UE_LOG(LogTemp, Display, TEXT("Net stats: %d client connections."), NetDriver->ClientConnections.Num());
+	if (NetDriver->ServerConnection) {
+		LogConnection(TEXT("Server"), NetDriver->ServerConnection);
+	}
+	for (const UNetConnection* Connection : NetDriver->ClientConnections) {
+		if (Connection) {
+			LogConnection(TEXT("Client"), Connection);
+		}
+	}
+}
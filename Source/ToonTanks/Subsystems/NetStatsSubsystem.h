@@ -0,0 +1,39 @@
+// -------------------------------------------------------------------------------------------
+/* Network test setup, all on one machine (from the project folder):
+ *
+ *   Listen server:     UE4Editor ToonTanks.uproject /Game/Maps/Main?listen -game -log
+ *   Headless clients:  UE4Editor ToonTanks.uproject 127.0.0.1 -game -nullrhi -nosound -unattended -log
+ *
+ * Start as many clients as you like. "ToonTanks.Net.Stats" on the server prints what every client
+ * connection is costing, and the same numbers go into "csvprofile" captures under the ToonTanks category.
+ * The bandwidth caps themselves are in DefaultEngine.ini (IpNetDriver and GameNetworkManager sections).
+*/
+// -------------------------------------------------------------------------------------------
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+
+#include "NetStatsSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+/// Bandwidth and packet loss for each connection of this World's net driver.
+UCLASS()
+class TOONTANKS_API UNetStatsSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Print every connection's in/out bytes per second, packets lost and ping.
+	void LogStats() const;
+};
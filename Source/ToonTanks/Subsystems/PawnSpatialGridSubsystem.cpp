@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PawnSpatialGridSubsystem.h"
+
+#include "ToonTanks/Pawns/PawnBase.h"
+
+// -------------------------------------------------------------------------------------------
+void UPawnSpatialGridSubsystem::Deinitialize()
+{
+	Cells.Empty();
+	PawnCells.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void UPawnSpatialGridSubsystem::RegisterPawn(APawnBase* Pawn)
+{
+	if (!Pawn || PawnCells.Contains(Pawn)) {
+		return;
+	}
+
+	const FVector Location = Pawn->GetActorLocation();
+	const float ThreatRange = Pawn->GetThreatRange();
+	const FIntPoint Cell = GetCell(Location);
+
+	MaxThreatRange = FMath::Max(MaxThreatRange, ThreatRange);
+	Cells.FindOrAdd(Cell).Add({Pawn, Location, ThreatRange * ThreatRange});
+	PawnCells.Add(Pawn, Cell);
+}
+
+// -------------------------------------------------------------------------------------------
+void UPawnSpatialGridSubsystem::UnregisterPawn(APawnBase* Pawn)
+{
+	FIntPoint Cell;
+	if (PawnCells.RemoveAndCopyValue(Pawn, Cell)) {
+		RemoveFromCell(Pawn, Cell);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called by pawns that move (the tank in MoveTank()). Most calls just update the cached location.
+void UPawnSpatialGridSubsystem::UpdatePawn(APawnBase* Pawn)
+{
+	FIntPoint* OldCell = PawnCells.Find(Pawn);
+	if (!OldCell) {
+		return;
+	}
+
+	const FVector Location = Pawn->GetActorLocation();
+	const FIntPoint NewCell = GetCell(Location);
+
+	// Still in the same cell, just refresh where we are inside it.
+	if (NewCell == *OldCell) {
+		for (FPawnGridEntry& Entry : Cells.FindChecked(NewCell)) {
+			if (Entry.Pawn == Pawn) {
+				Entry.Location = Location;
+				break;
+			}
+		}
+		return;
+	}
+
+	const float ThreatRange = Pawn->GetThreatRange();
+	RemoveFromCell(Pawn, *OldCell);
+	Cells.FindOrAdd(NewCell).Add({Pawn, Location, ThreatRange * ThreatRange});
+	*OldCell = NewCell;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Only look in the cells the query sphere overlaps, then do the exact (squared) distance check.
+void UPawnSpatialGridSubsystem::QueryPawnsInRadius(const FVector& Center, float Radius,
+	TArray<APawnBase*>& OutPawns) const
+{
+	const FIntPoint MinCell = GetCell(Center - FVector(Radius));
+	const FIntPoint MaxCell = GetCell(Center + FVector(Radius));
+	const float RadiusSquared = Radius * Radius;
+
+	for (int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++) {
+		for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++) {
+			const TArray<FPawnGridEntry>* Entries = Cells.Find(FIntPoint(CellX, CellY));
+			if (!Entries) {
+				continue;
+			}
+			for (const FPawnGridEntry& Entry : *Entries) {
+				if (FVector::DistSquared(Entry.Location, Center) <= RadiusSquared) {
+					OutPawns.Add(Entry.Pawn);
+				}
+			}
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Same idea as QueryPawnsInRadius(), but each pawn is tested against its own ThreatRange.
+void UPawnSpatialGridSubsystem::QueryPawnsThreatening(const FVector& Target, TArray<APawnBase*>& OutPawns) const
+{
+	const FIntPoint MinCell = GetCell(Target - FVector(MaxThreatRange));
+	const FIntPoint MaxCell = GetCell(Target + FVector(MaxThreatRange));
+
+	for (int32 CellX = MinCell.X; CellX <= MaxCell.X; CellX++) {
+		for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; CellY++) {
+			const TArray<FPawnGridEntry>* Entries = Cells.Find(FIntPoint(CellX, CellY));
+			if (!Entries) {
+				continue;
+			}
+			for (const FPawnGridEntry& Entry : *Entries) {
+				if (FVector::DistSquared(Entry.Location, Target) <= Entry.ThreatRangeSquared) {
+					OutPawns.Add(Entry.Pawn);
+				}
+			}
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+FIntPoint UPawnSpatialGridSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+// -------------------------------------------------------------------------------------------
+void UPawnSpatialGridSubsystem::RemoveFromCell(APawnBase* Pawn, const FIntPoint& Cell)
+{
+	TArray<FPawnGridEntry>* Entries = Cells.Find(Cell);
+	if (!Entries) {
+		return;
+	}
+
+	const int32 Index = Entries->IndexOfByPredicate([Pawn](const FPawnGridEntry& Entry) { return Entry.Pawn == Pawn; });
+	if (Index != INDEX_NONE) {
+		Entries->RemoveAtSwap(Index, 1, false);
+	}
+	if (Entries->Num() == 0) {
+		Cells.Remove(Cell);
+	}
+}
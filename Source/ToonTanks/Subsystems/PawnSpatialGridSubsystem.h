@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "PawnSpatialGridSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class APawnBase;
+
+// -------------------------------------------------------------------------------------------
+/// One pawn sitting in a grid cell. We keep a copy of its location so queries never touch the actor.
+struct FPawnGridEntry
+{
+	APawnBase* Pawn;
+	FVector Location;
+	/// The pawn's ThreatRange squared (0 for pawns that don't threaten anything).
+	float ThreatRangeSquared;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * A uniform spatial hash of every APawnBase in the World, bucketed by XY cell. \n
+ * Pawns add themselves in BeginPlay, and moving pawns call UpdatePawn() after they move,
+ * so "who is near this point" costs however many pawns are nearby, not every pawn in the level.
+ */
+UCLASS(Config=Game)
+class TOONTANKS_API UPawnSpatialGridSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Deinitialize() override;
+
+	void RegisterPawn(APawnBase* Pawn);
+	void UnregisterPawn(APawnBase* Pawn);
+	/// Re-read Pawn's location, only moving it to another bucket if it crossed into a new cell.
+	void UpdatePawn(APawnBase* Pawn);
+
+	/// Every pawn within Radius of Center. OutPawns is appended to, not cleared.
+	void QueryPawnsInRadius(const FVector& Center, float Radius, TArray<APawnBase*>& OutPawns) const;
+	/// Every pawn that has Target inside its own ThreatRange (which turrets can see Target?).
+	void QueryPawnsThreatening(const FVector& Target, TArray<APawnBase*>& OutPawns) const;
+
+private:
+	// ---------------------------------------------------------
+	FIntPoint GetCell(const FVector& Location) const;
+	void RemoveFromCell(APawnBase* Pawn, const FIntPoint& Cell);
+
+	/// Size of one grid cell in world units. Around the typical ThreatRange works best.
+	UPROPERTY(Config)
+	float CellSize = 2500;
+
+	/// The biggest ThreatRange we've seen, so threat queries know how far out to look.
+	float MaxThreatRange = 0;
+
+	// Pawns take themselves out in EndPlay, so these never outlive the actors they point to.
+	TMap<FIntPoint, TArray<FPawnGridEntry>> Cells;
+	TMap<APawnBase*, FIntPoint> PawnCells;
+};
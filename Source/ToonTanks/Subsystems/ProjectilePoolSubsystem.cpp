@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectilePoolSubsystem.h"
+
+#include "ToonTanks/Actors/ProjectileBase.h"
+#include "ToonTanks/ToonTanksStats.h"
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.ProjectilePool.Stats" in the console to see how well the pool is doing.
+static FAutoConsoleCommandWithWorld ProjectilePoolStatsCommand(
+	TEXT("ToonTanks.ProjectilePool.Stats"),
+	TEXT("Print projectile pool hit/miss counters for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UProjectilePoolSubsystem* ProjectilePool = World ? World->GetSubsystem<UProjectilePoolSubsystem>() : nullptr) {
+			ProjectilePool->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+void UProjectilePoolSubsystem::Deinitialize()
+{
+	// The actors themselves get cleaned up with the World, we just drop our references.
+	Pools.Empty();
+	// Anything still flying goes away with the World too, without coming back through ReleaseProjectile().
+	DEC_DWORD_STAT_BY(STAT_ToonTanks_ProjectilesAlive, NumInFlight);
+	NumInFlight = 0;
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Fill the pool for ProjectileClass up to the PoolSize set on its defaults. \n
+/// Safe to call from every pawn that uses this class, it only spawns what's missing.
+void UProjectilePoolSubsystem::Prewarm(TSubclassOf<AProjectileBase> ProjectileClass)
+{
+	if (!ProjectileClass) {
+		return;
+	}
+
+	FProjectilePool& Pool = Pools.FindOrAdd(ProjectileClass);
+	const int32 PoolSize = ProjectileClass->GetDefaultObject<AProjectileBase>()->GetPoolSize();
+
+	while (Pool.TotalSpawned < PoolSize) {
+		AProjectileBase* Projectile = SpawnPooledProjectile(ProjectileClass, Pool);
+		if (!Projectile) {
+			return;
+		}
+		Projectile->DeactivateToPool();
+		Pool.Inactive.Push(Projectile);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Grab an inactive projectile of ProjectileClass and launch it from Location towards Rotation. \n
+/// If the pool is empty we spawn a new one, which will join the pool once it explodes.
+AProjectileBase* UProjectilePoolSubsystem::AcquireProjectile(TSubclassOf<AProjectileBase> ProjectileClass,
+	const FVector& Location, const FRotator& Rotation, AActor* NewOwner)
+{
+	if (!ProjectileClass) {
+		return nullptr;
+	}
+
+	FProjectilePool& Pool = Pools.FindOrAdd(ProjectileClass);
+	AProjectileBase* Projectile = nullptr;
+
+	// Something else (like the level ending) could have destroyed a pooled projectile, so skip those.
+	while (Pool.Inactive.Num() > 0 && !Projectile) {
+		AProjectileBase* Candidate = Pool.Inactive.Pop(false);
+		if (IsValid(Candidate)) {
+			Projectile = Candidate;
+		}
+		else {
+			Pool.TotalSpawned--;
+		}
+	}
+
+	if (Projectile) {
+		PoolHits++;
+	}
+	else {
+		PoolMisses++;
+		Projectile = SpawnPooledProjectile(ProjectileClass, Pool);
+		if (!Projectile) {
+			return nullptr;
+		}
+	}
+
+	Projectile->ActivateFromPool(Location, Rotation, NewOwner);
+
+	NumInFlight++;
+	TOONTANKS_COUNT(ProjectilesLaunched, 1);
+	INC_DWORD_STAT(STAT_ToonTanks_ProjectilesAlive);
+	CSV_CUSTOM_STAT(ToonTanks, ProjectilesAlive, NumInFlight, ECsvCustomStatOp::Set);
+	return Projectile;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Hide and stop the projectile, then store it for the next AcquireProjectile() of its class. \n
+/// Releasing one that's already back (a hit and a timer both getting there) does nothing,
+/// otherwise it'd be in Inactive twice and get handed to two shooters.
+void UProjectilePoolSubsystem::ReleaseProjectile(AProjectileBase* Projectile)
+{
+	if (!IsValid(Projectile) || !Projectile->IsLaunched()) {
+		return;
+	}
+
+	Projectile->DeactivateToPool();
+	Pools.FindOrAdd(Projectile->GetClass()).Inactive.Push(Projectile);
+
+	NumInFlight = FMath::Max(NumInFlight - 1, 0);
+	DEC_DWORD_STAT(STAT_ToonTanks_ProjectilesAlive);
+	CSV_CUSTOM_STAT(ToonTanks, ProjectilesAlive, NumInFlight, ECsvCustomStatOp::Set);
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectilePoolSubsystem::LogStats() const
+{
+	const int32 Requests = PoolHits + PoolMisses;
+	const float HitRate = Requests > 0 ? 100.f * PoolHits / Requests : 0.f;
+	UE_LOG(LogTemp, Display, TEXT("Projectile pool: %d hits, %d misses (%.1f%% hit rate)."), PoolHits, PoolMisses, HitRate);
+
+	for (const TPair<UClass*, FProjectilePool>& Pair : Pools) {
+		UE_LOG(LogTemp, Display, TEXT("  %s: %d spawned, %d inactive."),
+			*GetNameSafe(Pair.Key), Pair.Value.TotalSpawned, Pair.Value.Inactive.Num());
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Spawn a new projectile for the pool. It's launched or deactivated by whoever called us.
+AProjectileBase* UProjectilePoolSubsystem::SpawnPooledProjectile(TSubclassOf<AProjectileBase> ProjectileClass,
+	FProjectilePool& Pool)
+{
+	FActorSpawnParameters SpawnParams;
+	// Pooled projectiles all get spawned at the origin, so don't let them fail spawning on top of each other.
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AProjectileBase* Projectile = GetWorld()->SpawnActor<AProjectileBase>(
+		ProjectileClass,
+		FVector::ZeroVector,
+		FRotator::ZeroRotator,
+		SpawnParams);
+
+	if (Projectile) {
+		Pool.TotalSpawned++;
+		TOONTANKS_COUNT(ProjectilesSpawned, 1);
+	}
+	return Projectile;
+}
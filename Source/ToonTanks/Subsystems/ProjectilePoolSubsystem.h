@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "ProjectilePoolSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class AProjectileBase;
+
+// -------------------------------------------------------------------------------------------
+/// All the inactive projectiles we have lying around for one ProjectileClass.
+USTRUCT()
+struct FProjectilePool
+{
+	GENERATED_BODY()
+
+	/// Projectiles that are hidden, not moving, and ready to be handed out again.
+	UPROPERTY()
+	TArray<AProjectileBase*> Inactive;
+
+	/// How many projectiles this pool has ever spawned (active + inactive).
+	int32 TotalSpawned = 0;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Keeps a pool of projectiles per ProjectileClass, so firing doesn't have to
+ * SpawnActor() and exploding doesn't have to Destroy() every single time.
+ * One of these lives in every World, and anything can grab it with GetWorld()->GetSubsystem<>().
+ */
+UCLASS()
+class TOONTANKS_API UProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Deinitialize() override;
+
+	/// Spawn inactive projectiles of ProjectileClass until the pool holds at least its PoolSize.
+	void Prewarm(TSubclassOf<AProjectileBase> ProjectileClass);
+	/// Hand out a projectile from the pool (or spawn one if the pool is empty) and launch it.
+	AProjectileBase* AcquireProjectile(
+		TSubclassOf<AProjectileBase> ProjectileClass,
+		const FVector& Location,
+		const FRotator& Rotation,
+		AActor* NewOwner
+		);
+	/// Put a projectile back in its pool so it can be fired again later. Does nothing if it's already there.
+	void ReleaseProjectile(AProjectileBase* Projectile);
+
+	/// How many times AcquireProjectile() found a projectile waiting in the pool.
+	int32 GetPoolHits() const { return PoolHits; }
+	/// How many times AcquireProjectile() had to spawn a brand new projectile.
+	int32 GetPoolMisses() const { return PoolMisses; }
+	/// How many projectiles are out flying right now.
+	int32 GetNumInFlight() const { return NumInFlight; }
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	AProjectileBase* SpawnPooledProjectile(TSubclassOf<AProjectileBase> ProjectileClass, FProjectilePool& Pool);
+
+	UPROPERTY()
+	TMap<UClass*, FProjectilePool> Pools;
+
+	int32 PoolHits = 0;
+	int32 PoolMisses = 0;
+	/// Projectiles handed out and not back yet.
+	int32 NumInFlight = 0;
+};
@@ -0,0 +1,535 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileSimulationSubsystem.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "GameFramework/WorldSettings.h"
+#include "Kismet/GameplayStatics.h"
+#include "ToonTanks/Actors/ProjectileBase.h"
+#include "ToonTanks/Pawns/PawnBase.h"
+#include "ToonTanks/Subsystems/AudioEventSubsystem.h"
+#include "ToonTanks/Subsystems/EffectsSubsystem.h"
+#include "ToonTanks/Subsystems/ExplosionSubsystem.h"
+#include "ToonTanks/Subsystems/SceneQuerySubsystem.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/Subsystems/WeaponDefinitionSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+#define OUT
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.ProjectileSimulation.Stats" in the console to see how many are in the air, per class.
+static FAutoConsoleCommandWithWorld ProjectileSimulationStatsCommand(
+	TEXT("ToonTanks.ProjectileSimulation.Stats"),
+	TEXT("Print how many lightweight projectiles are in flight for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UProjectileSimulationSubsystem* Simulation = World ? World->GetSubsystem<UProjectileSimulationSubsystem>() : nullptr) {
+			Simulation->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+void FSimulatedProjectileBatch::RemoveAtSwap(int32 Index)
+{
+	Owners.RemoveAtSwap(Index, 1, false);
+	PositionsX.RemoveAtSwap(Index, 1, false);
+	PositionsY.RemoveAtSwap(Index, 1, false);
+	PositionsZ.RemoveAtSwap(Index, 1, false);
+	VelocitiesX.RemoveAtSwap(Index, 1, false);
+	VelocitiesY.RemoveAtSwap(Index, 1, false);
+	VelocitiesZ.RemoveAtSwap(Index, 1, false);
+	Ages.RemoveAtSwap(Index, 1, false);
+	Fuses.RemoveAtSwap(Index, 1, false);
+	Resting.RemoveAtSwap(Index, 1, false);
+	ImpactSoundTimes.RemoveAtSwap(Index, 1, false);
+	LastHitComponents.RemoveAtSwap(Index, 1, false);
+	LastHitTags.RemoveAtSwap(Index, 1, false);
+	LastHitTimes.RemoveAtSwap(Index, 1, false);
+	Traces.RemoveAtSwap(Index, 1, false);
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectileSimulationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	AudioEvents = Cast<UAudioEventSubsystem>(Collection.InitializeDependency(UAudioEventSubsystem::StaticClass()));
+	Effects = Cast<UEffectsSubsystem>(Collection.InitializeDependency(UEffectsSubsystem::StaticClass()));
+	Explosions = Cast<UExplosionSubsystem>(Collection.InitializeDependency(UExplosionSubsystem::StaticClass()));
+	Weapons = Cast<UWeaponDefinitionSubsystem>(Collection.InitializeDependency(UWeaponDefinitionSubsystem::StaticClass()));
+	SceneQueries = Cast<USceneQuerySubsystem>(Collection.InitializeDependency(USceneQuerySubsystem::StaticClass()));
+
+	// With a fixed timestep, fly in the simulation steps, same as the pawns that fire us.
+	USimulationClockSubsystem* SimulationClock = Cast<USimulationClockSubsystem>(
+		Collection.InitializeDependency(USimulationClockSubsystem::StaticClass()));
+	if (SimulationClock && SimulationClock->IsFixedStep()) {
+		IsFixedStep = true;
+		SimulationClock->OnStep.AddUObject(this, &UProjectileSimulationSubsystem::UpdateBatches);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectileSimulationSubsystem::Deinitialize()
+{
+	// The instanced meshes go away with the Renderer, which goes away with the World.
+	DEC_DWORD_STAT_BY(STAT_ToonTanks_SimulatedProjectiles, NumInFlight);
+	NumInFlight = 0;
+	Batches.Empty();
+	Renderer = nullptr;
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+/// Move everything (unless the fixed steps already did), then draw the result once per frame.
+void UProjectileSimulationSubsystem::Tick(float DeltaTime)
+{
+	if (!IsFixedStep) {
+		UpdateBatches(DeltaTime);
+	}
+
+	TOONTANKS_SCOPE_CYCLE(ProjectileSimulation);
+	for (TPair<UClass*, FSimulatedProjectileBatch>& Entry : Batches) {
+		UpdateInstances(Entry.Value);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Read last frame's traces, move everything, then trace the moves.
+void UProjectileSimulationSubsystem::UpdateBatches(float DeltaTime)
+{
+	TOONTANKS_SCOPE_CYCLE(ProjectileSimulation);
+
+	const bool IsAsync = SceneQueries && SceneQueries->UsesAsync();
+	for (TPair<UClass*, FSimulatedProjectileBatch>& Entry : Batches) {
+		FSimulatedProjectileBatch& Batch = Entry.Value;
+		if (IsAsync) {
+			ReadTraces(Batch);
+		}
+		Integrate(Batch, DeltaTime);
+		UpdateProjectiles(Batch, DeltaTime);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType UProjectileSimulationSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+bool UProjectileSimulationSubsystem::IsTickable() const
+{
+	return NumInFlight > 0 || HasStaleInstances;
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* UProjectileSimulationSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId UProjectileSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSimulationSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Add a projectile to the end of its class's arrays, flying from Location towards Rotation.
+void UProjectileSimulationSubsystem::Launch(TSubclassOf<AProjectileBase> ProjectileClass, const FVector& Location,
+	const FRotator& Rotation, AActor* Owner)
+{
+	if (!ProjectileClass) {
+		return;
+	}
+
+	FSimulatedProjectileBatch& Batch = FindOrAddBatch(ProjectileClass);
+	const FWeaponDefinition& Weapon = Weapons->GetWeapon(Batch.WeaponId);
+	const FVector Velocity = Rotation.Vector() * Weapon.MoveSpeedStart;
+
+	Batch.Owners.Add(Owner);
+	Batch.PositionsX.Add(Location.X);
+	Batch.PositionsY.Add(Location.Y);
+	Batch.PositionsZ.Add(Location.Z);
+	Batch.VelocitiesX.Add(Velocity.X);
+	Batch.VelocitiesY.Add(Velocity.Y);
+	Batch.VelocitiesZ.Add(Velocity.Z);
+	Batch.Ages.Add(0);
+	Batch.Fuses.Add(-1);
+	Batch.Resting.Add(0);
+	Batch.ImpactSoundTimes.Add(0);
+	Batch.LastHitComponents.AddDefaulted();
+	Batch.LastHitTags.Add(EPawnTags::None);
+	Batch.LastHitTimes.Add(0);
+	Batch.Traces.AddDefaulted();
+
+	NumInFlight++;
+	INC_DWORD_STAT(STAT_ToonTanks_SimulatedProjectiles);
+	TOONTANKS_COUNT(ProjectilesLaunched, 1);
+
+	AudioEvents->PlaySoundAtLocation(Batch.Archetype->LaunchSound, Location, ToonTanksSoundPriority::Launch);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Read everything that's the same for every projectile of the class off its default object,
+/// and give it an instanced mesh to be drawn with.
+FSimulatedProjectileBatch& UProjectileSimulationSubsystem::FindOrAddBatch(TSubclassOf<AProjectileBase> ProjectileClass)
+{
+	if (FSimulatedProjectileBatch* Batch = Batches.Find(ProjectileClass)) {
+		return *Batch;
+	}
+
+	FSimulatedProjectileBatch& Batch = Batches.Add(ProjectileClass);
+	AProjectileBase* Archetype = ProjectileClass->GetDefaultObject<AProjectileBase>();
+	const UProjectileMovementComponent* Movement = Archetype->ProjectileMovement;
+
+	Batch.Archetype = Archetype;
+	Batch.WeaponId = Weapons->FindWeaponId(Archetype);
+	Batch.GravityZ = Movement->ShouldApplyGravity() ? GetWorld()->GetGravityZ() * Movement->ProjectileGravityScale : 0;
+	Batch.ShouldBounce = Movement->bShouldBounce;
+	Batch.Bounciness = Movement->Bounciness;
+	Batch.Friction = Movement->Friction;
+	Batch.BounceAngleAffectsFriction = Movement->bBounceAngleAffectsFriction;
+	Batch.BounceStopSpeed = Movement->BounceVelocityStopSimulatingThreshold;
+	Batch.MeshScale = Archetype->ProjectileMesh->GetRelativeScale3D();
+
+	// Nobody's looking on a dedicated server.
+	if (GetWorld()->GetNetMode() == NM_DedicatedServer) {
+		return Batch;
+	}
+
+	if (!Renderer) {
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.ObjectFlags |= RF_Transient;
+		Renderer = GetWorld()->SpawnActor<AActor>(SpawnParameters);
+	}
+	if (Renderer) {
+		UInstancedStaticMeshComponent* Instances = NewObject<UInstancedStaticMeshComponent>(Renderer);
+		Instances->SetStaticMesh(Archetype->ProjectileMesh->GetStaticMesh());
+		for (int32 MaterialIndex = 0; MaterialIndex < Archetype->ProjectileMesh->GetNumMaterials(); MaterialIndex++) {
+			Instances->SetMaterial(MaterialIndex, Archetype->ProjectileMesh->GetMaterial(MaterialIndex));
+		}
+		// Just for looks, the traces do the colliding.
+		Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Instances->SetMobility(EComponentMobility::Movable);
+		if (!Renderer->GetRootComponent()) {
+			Renderer->SetRootComponent(Instances);
+		}
+		Instances->RegisterComponent();
+		Batch.Instances = Instances;
+	}
+	return Batch;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Backwards, so a projectile removed by its hit gets replaced by one we've already looked at.
+void UProjectileSimulationSubsystem::ReadTraces(FSimulatedProjectileBatch& Batch)
+{
+	FTraceDatum Datum;
+	for (int32 Index = Batch.Num() - 1; Index >= 0; Index--) {
+		FTraceHandle& Trace = Batch.Traces[Index];
+		if (!Trace.IsValid()) {
+			continue;
+		}
+
+		const bool HasResult = GetWorld()->QueryTraceData(Trace, OUT Datum);
+		Trace = FTraceHandle();
+		if (HasResult && Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit) {
+			HandleHit(Batch, Index, Datum.OutHits[0]);
+		}
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Gravity, MaxSpeed, then move by the average of the old and new velocity, the same as
+/// UProjectileMovementComponent. No branches in here, so the compiler is free to vectorize it.
+void UProjectileSimulationSubsystem::Integrate(FSimulatedProjectileBatch& Batch, float DeltaTime)
+{
+	const int32 Num = Batch.Num();
+	const float MaxSpeed = Weapons->GetWeapon(Batch.WeaponId).MoveSpeedMax;
+	// A MaxSpeed of 0 means no limit.
+	const float SpeedLimit = MaxSpeed > 0 ? MaxSpeed : BIG_NUMBER;
+	const float GravityStep = Batch.GravityZ * DeltaTime;
+	const float HalfStep = 0.5f * DeltaTime;
+
+	// Where each move starts, for the traces.
+	StartsX = Batch.PositionsX;
+	StartsY = Batch.PositionsY;
+	StartsZ = Batch.PositionsZ;
+
+	float* RESTRICT X = Batch.PositionsX.GetData();
+	float* RESTRICT Y = Batch.PositionsY.GetData();
+	float* RESTRICT Z = Batch.PositionsZ.GetData();
+	float* RESTRICT VelocityX = Batch.VelocitiesX.GetData();
+	float* RESTRICT VelocityY = Batch.VelocitiesY.GetData();
+	float* RESTRICT VelocityZ = Batch.VelocitiesZ.GetData();
+	float* RESTRICT Age = Batch.Ages.GetData();
+	const uint8* RESTRICT RestingFlags = Batch.Resting.GetData();
+
+	for (int32 Index = 0; Index < Num; Index++) {
+		const float Moving = 1.f - RestingFlags[Index];
+		float NewVelocityX = VelocityX[Index] * Moving;
+		float NewVelocityY = VelocityY[Index] * Moving;
+		float NewVelocityZ = (VelocityZ[Index] + GravityStep) * Moving;
+
+		const float SpeedSquared = NewVelocityX * NewVelocityX + NewVelocityY * NewVelocityY + NewVelocityZ * NewVelocityZ;
+		const float Scale = FMath::Min(1.f, SpeedLimit * FMath::InvSqrt(FMath::Max(SpeedSquared, SMALL_NUMBER)));
+		NewVelocityX *= Scale;
+		NewVelocityY *= Scale;
+		NewVelocityZ *= Scale;
+
+		X[Index] += (VelocityX[Index] + NewVelocityX) * HalfStep;
+		Y[Index] += (VelocityY[Index] + NewVelocityY) * HalfStep;
+		Z[Index] += (VelocityZ[Index] + NewVelocityZ) * HalfStep;
+		VelocityX[Index] = NewVelocityX;
+		VelocityY[Index] = NewVelocityY;
+		VelocityZ[Index] = NewVelocityZ;
+		Age[Index] += DeltaTime;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Backwards, so removing one (swapping the last one into its slot) never skips anybody.
+void UProjectileSimulationSubsystem::UpdateProjectiles(FSimulatedProjectileBatch& Batch, float DeltaTime)
+{
+	const FWeaponDefinition& Weapon = Weapons->GetWeapon(Batch.WeaponId);
+	// Same as the LifeSpanTimer in AProjectileBase::ActivateFromPool().
+	const float MaxAge = Weapon.LifeSpan * 2;
+	const AWorldSettings* WorldSettings = GetWorld()->GetWorldSettings();
+	const float KillZ = WorldSettings && WorldSettings->bEnableWorldBoundsChecks ? WorldSettings->KillZ : -BIG_NUMBER;
+	const bool IsAsync = SceneQueries && SceneQueries->UsesAsync();
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(SimulatedProjectile), false);
+	int32 NumTraces = 0;
+
+	for (int32 Index = Batch.Num() - 1; Index >= 0; Index--) {
+		// Went past their lifespan without exploding, or fell off the map: gone without a bang.
+		if (Batch.Ages[Index] > MaxAge || Batch.PositionsZ[Index] < KillZ) {
+			Remove(Batch, Index);
+			continue;
+		}
+
+		if (Batch.Fuses[Index] >= 0) {
+			Batch.Fuses[Index] -= DeltaTime;
+			if (Batch.Fuses[Index] <= 0) {
+				Explode(Batch, Index);
+				continue;
+			}
+		}
+
+		if (Batch.Resting[Index]) {
+			continue;
+		}
+
+		// Same as the projectile's sweep: don't hit whoever fired us.
+		Params.ClearIgnoredActors();
+		if (Batch.Owners[Index]) {
+			Params.AddIgnoredActor(Batch.Owners[Index]);
+		}
+		const FVector Start(StartsX[Index], StartsY[Index], StartsZ[Index]);
+		const FVector End(Batch.PositionsX[Index], Batch.PositionsY[Index], Batch.PositionsZ[Index]);
+		NumTraces++;
+
+		if (IsAsync) {
+			Batch.Traces[Index] = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, ECC_WorldDynamic, Params);
+			continue;
+		}
+		FHitResult Hit;
+		if (GetWorld()->LineTraceSingleByChannel(OUT Hit, Start, End, ECC_WorldDynamic, Params)) {
+			HandleHit(Batch, Index, Hit);
+		}
+	}
+
+	TOONTANKS_COUNT(Sweeps, NumTraces);
+}
+
+// -------------------------------------------------------------------------------------------
+/// One batched transform update per class. Instances past the end of the batch are scaled down to nothing,
+/// so we never have to add or remove instances in the middle.
+void UProjectileSimulationSubsystem::UpdateInstances(FSimulatedProjectileBatch& Batch)
+{
+	UInstancedStaticMeshComponent* Instances = Batch.Instances;
+	if (!Instances) {
+		return;
+	}
+
+	const int32 Num = Batch.Num();
+	const int32 NumToUpdate = FMath::Max(Num, Batch.NumInstancesShown);
+	Transforms.Reset(NumToUpdate);
+
+	for (int32 Index = 0; Index < Num; Index++) {
+		const FVector Velocity(Batch.VelocitiesX[Index], Batch.VelocitiesY[Index], Batch.VelocitiesZ[Index]);
+		Transforms.Emplace(
+			Velocity.IsNearlyZero() ? FQuat::Identity : Velocity.ToOrientationQuat(),
+			FVector(Batch.PositionsX[Index], Batch.PositionsY[Index], Batch.PositionsZ[Index]),
+			Batch.MeshScale);
+	}
+	for (int32 Index = Num; Index < NumToUpdate; Index++) {
+		Transforms.Emplace(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+	}
+
+	const int32 NumInstances = Instances->GetInstanceCount();
+	if (NumToUpdate > NumInstances) {
+		const TArray<FTransform> NewInstances(Transforms.GetData() + NumInstances, NumToUpdate - NumInstances);
+		Instances->AddInstances(NewInstances, false);
+	}
+	if (NumToUpdate > 0) {
+		Instances->BatchUpdateInstancesTransforms(0, Transforms, true, true, true);
+	}
+
+	Batch.NumInstancesShown = Num;
+	HasStaleInstances = false;
+	for (const TPair<UClass*, FSimulatedProjectileBatch>& Entry : Batches) {
+		HasStaleInstances |= Entry.Value.NumInstancesShown > 0;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Direct hits on pawns damage them and explode right away, anything else we bounce off and light the fuse.
+bool UProjectileSimulationSubsystem::HandleHit(FSimulatedProjectileBatch& Batch, int32 Index, const FHitResult& Hit)
+{
+	const AProjectileBase* Archetype = Batch.Archetype;
+	AActor* Owner = Batch.Owners[Index];
+	AActor* OtherActor = Hit.GetActor();
+	const FVector Location = Hit.Location;
+
+	// Move to where we hit, nudged off the surface, and bounce the way UProjectileMovementComponent would.
+	FVector Velocity(Batch.VelocitiesX[Index], Batch.VelocitiesY[Index], Batch.VelocitiesZ[Index]);
+	const float VelocityDotNormal = Velocity | Hit.Normal;
+	if (!Batch.ShouldBounce) {
+		Velocity = FVector::ZeroVector;
+	}
+	else if (VelocityDotNormal < 0) {
+		const FVector ProjectedNormal = Hit.Normal * -VelocityDotNormal;
+		Velocity += ProjectedNormal;
+		const float ScaledFriction = Batch.BounceAngleAffectsFriction
+			? FMath::Clamp(-VelocityDotNormal / FMath::Max(Velocity.Size(), KINDA_SMALL_NUMBER), 0.f, 1.f) * Batch.Friction
+			: Batch.Friction;
+		Velocity *= FMath::Clamp(1.f - ScaledFriction, 0.f, 1.f);
+		Velocity += ProjectedNormal * FMath::Max(Batch.Bounciness, 0.f);
+	}
+	const bool Stopped = Velocity.SizeSquared() < FMath::Square(Batch.BounceStopSpeed);
+
+	Batch.PositionsX[Index] = Location.X + Hit.Normal.X;
+	Batch.PositionsY[Index] = Location.Y + Hit.Normal.Y;
+	Batch.PositionsZ[Index] = Location.Z + Hit.Normal.Z;
+	Batch.VelocitiesX[Index] = Stopped ? 0 : Velocity.X;
+	Batch.VelocitiesY[Index] = Stopped ? 0 : Velocity.Y;
+	Batch.VelocitiesZ[Index] = Stopped ? 0 : Velocity.Z;
+	Batch.Resting[Index] = Stopped;
+
+	// Rolling along the floor is one bounce, not one per frame: no sound, and the fuse keeps counting from the first hit.
+	const float Now = USimulationClockSubsystem::GetGameplayTime(GetWorld());
+	UPrimitiveComponent* OtherComp = Hit.GetComponent();
+	const bool IsSameComponent = OtherComp && Batch.LastHitComponents[Index].Get() == OtherComp;
+	if (IsSameComponent && Batch.LastHitTags[Index] == EPawnTags::None
+		&& Now - Batch.LastHitTimes[Index] < AProjectileBase::GetRepeatedHitWindow()) {
+		Batch.LastHitTimes[Index] = Now;
+		TOONTANKS_COUNT(RepeatedHitsFiltered, 1);
+		return false;
+	}
+	if (!IsSameComponent) {
+		Batch.LastHitComponents[Index] = OtherComp;
+		Batch.LastHitTags[Index] = APawnBase::GetTagsOf(OtherActor);
+	}
+	Batch.LastHitTimes[Index] = Now;
+
+	// No owner means our shooter is gone. Like a pooled projectile, we just keep bouncing until our lifespan's up.
+	if (!Owner) {
+		return false;
+	}
+
+	const EPawnTags Tags = Batch.LastHitTags[Index];
+	const bool IsTurret = EnumHasAnyFlags(Tags, EPawnTags::Turret);
+	const bool IsTank = EnumHasAnyFlags(Tags, EPawnTags::Tank);
+
+	// A client's projectile is just for show, the server's copy of it does the damage.
+	if (EnumHasAnyFlags(Tags, EPawnTags::Damageable) && (IsTurret || (IsTank && OtherActor != Owner)) && !IsCosmetic()) {
+		Effects->SpawnEffect(Archetype->HitParticle, Location);
+		PlayImpactSound(Batch, Index, Archetype->DirectImpactSound, ToonTanksSoundPriority::DirectImpact);
+
+		// There's no projectile actor, so the one who fired us is the damage causer too.
+		UGameplayStatics::ApplyDamage(
+			OtherActor,
+			Weapons->GetWeapon(Batch.WeaponId).Damage,
+			Owner->GetInstigatorController(),
+			Owner,
+			Archetype->DamageType
+			);
+	}
+
+	if (IsTank && !IsCosmetic()) {
+		APawn* HitPawn = Cast<APawn>(OtherActor);
+		if (APlayerController* PlayerController = HitPawn ? Cast<APlayerController>(HitPawn->GetController()) : nullptr) {
+			PlayerController->ClientStartCameraShake(Archetype->HitShake, Archetype->HitShakeScale);
+		}
+	}
+
+	if (IsTurret || IsTank) {
+		Explode(Batch, Index);
+		return true;
+	}
+
+	PlayImpactSound(Batch, Index, Archetype->ImpactSound, ToonTanksSoundPriority::Impact);
+	Batch.Fuses[Index] = Weapons->GetWeapon(Batch.WeaponId).ExplosionTimer;
+	return false;
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectileSimulationSubsystem::PlayImpactSound(FSimulatedProjectileBatch& Batch, int32 Index, USoundBase* Sound, float Priority)
+{
+	const float WorldTime = USimulationClockSubsystem::GetGameplayTime(GetWorld());
+	if (WorldTime - Batch.ImpactSoundTimes[Index] >= AProjectileBase::GetImpactSoundCooldown()) {
+		Batch.ImpactSoundTimes[Index] = WorldTime;
+		const FVector Location(Batch.PositionsX[Index], Batch.PositionsY[Index], Batch.PositionsZ[Index]);
+		AudioEvents->PlaySoundAtLocation(Sound, Location, Priority);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectileSimulationSubsystem::Explode(FSimulatedProjectileBatch& Batch, int32 Index)
+{
+	const AProjectileBase* Archetype = Batch.Archetype;
+	const FVector Location(Batch.PositionsX[Index], Batch.PositionsY[Index], Batch.PositionsZ[Index]);
+
+	AudioEvents->PlaySoundAtLocation(Archetype->ExplosionSound, Location, ToonTanksSoundPriority::Explosion);
+	Effects->SpawnEffect(Archetype->ExplosionParticle, Location);
+
+	// Physics objects get their movement replicated from the server, so only push them there.
+	// Splash damage too.
+	if (!IsCosmetic()) {
+		Explosions->QueueWeaponExplosion(Location, Weapons->GetWeapon(Batch.WeaponId), Batch.Owners[Index]);
+	}
+
+	Remove(Batch, Index);
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectileSimulationSubsystem::Remove(FSimulatedProjectileBatch& Batch, int32 Index)
+{
+	Batch.RemoveAtSwap(Index);
+	NumInFlight--;
+	DEC_DWORD_STAT(STAT_ToonTanks_SimulatedProjectiles);
+}
+
+// -------------------------------------------------------------------------------------------
+void UProjectileSimulationSubsystem::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Projectile simulation: %d in flight"), NumInFlight);
+	for (const TPair<UClass*, FSimulatedProjectileBatch>& Entry : Batches) {
+		const FSimulatedProjectileBatch& Batch = Entry.Value;
+		int32 NumResting = 0;
+		for (const uint8 IsResting : Batch.Resting) {
+			NumResting += IsResting;
+		}
+		UE_LOG(LogTemp, Log, TEXT("  %s: %d in flight (%d resting), %d instances"),
+			*GetNameSafe(Entry.Key),
+			Batch.Num(),
+			NumResting,
+			Batch.Instances ? Batch.Instances->GetInstanceCount() : 0);
+	}
+}
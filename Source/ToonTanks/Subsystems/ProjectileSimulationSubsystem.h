@@ -0,0 +1,165 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+
+#include "ProjectileSimulationSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class AProjectileBase;
+class UAudioEventSubsystem;
+class UEffectsSubsystem;
+class UExplosionSubsystem;
+class UInstancedStaticMeshComponent;
+class USceneQuerySubsystem;
+class USoundBase;
+class UWeaponDefinitionSubsystem;
+enum class EPawnTags : uint8;
+
+// -------------------------------------------------------------------------------------------
+/// Every simulated projectile of one ProjectileClass, as a "struct of arrays" (all indexed the same).
+USTRUCT()
+struct FSimulatedProjectileBatch
+{
+	GENERATED_BODY()
+
+	/// The class default object. Meshes, sounds, effects and bounce settings all come from here.
+	UPROPERTY()
+	AProjectileBase* Archetype = nullptr;
+	/// Draws every projectile in the batch. Null on a dedicated server.
+	UPROPERTY()
+	UInstancedStaticMeshComponent* Instances = nullptr;
+	/// Who fired each projectile. A UPROPERTY so it gets nulled out if they're destroyed while we're in the air.
+	UPROPERTY()
+	TArray<AActor*> Owners;
+
+	// Everything below lines up with Owners by index.
+	TArray<float> PositionsX;
+	TArray<float> PositionsY;
+	TArray<float> PositionsZ;
+	TArray<float> VelocitiesX;
+	TArray<float> VelocitiesY;
+	TArray<float> VelocitiesZ;
+	/// Seconds since launch.
+	TArray<float> Ages;
+	/// Seconds until we explode, restarted on every bounce. Negative until we hit something.
+	TArray<float> Fuses;
+	/// 1 once we've stopped bouncing: no more gravity or traces, we just sit there until the fuse runs out.
+	TArray<uint8> Resting;
+	/// When each one last played an impact sound, same cooldown as AProjectileBase::PlayImpactSound().
+	TArray<float> ImpactSoundTimes;
+	/// What each one last hit, its tags and when, so rolling along the floor is one bounce (same as AProjectileBase::OnHit()).
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> LastHitComponents;
+	TArray<EPawnTags> LastHitTags;
+	TArray<float> LastHitTimes;
+	/// The async trace for our last move, waiting to be read at the start of this frame.
+	TArray<FTraceHandle> Traces;
+
+	// Per class, read once from the Archetype and its weapon.
+	int32 WeaponId = 0;
+	float GravityZ = 0;
+	bool ShouldBounce = false;
+	float Bounciness = 0;
+	float Friction = 0;
+	bool BounceAngleAffectsFriction = false;
+	float BounceStopSpeed = 0;
+	FVector MeshScale = FVector::OneVector;
+	/// How many instances were showing a projectile last frame (the rest are scaled down to nothing).
+	int32 NumInstancesShown = 0;
+
+	int32 Num() const { return Owners.Num(); }
+	void RemoveAtSwap(int32 Index);
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * A second projectile backend for high volume fire: projectiles are plain structs in packed arrays,
+ * not actors. Pick it per projectile class with AProjectileBase::UseLightweightSimulation. \n
+ * Every frame we integrate every projectile in one vectorizable loop (gravity, MaxSpeed, same integration
+ * as UProjectileMovementComponent), trace each move with the engine's batched async line traces
+ * (read back at the start of the next frame, or right away with ToonTanks.SceneQueries.Async off),
+ * and draw each class with a single instanced static mesh. \n
+ * Hits do what AProjectileBase::OnHit() does: damage, camera shake, sounds and effects, bouncing,
+ * and the explosion (through the ExplosionSubsystem) once the fuse runs out or we hit a pawn.
+ * There's no per-projectile Blueprint logic or components, which is the point. \n
+ * On a fixed timestep everything moves in the simulation steps instead (see USimulationClockSubsystem),
+ * with blocking traces, so hits land in the step that made them.
+ */
+UCLASS()
+class TOONTANKS_API UProjectileSimulationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Same as the projectile pool's AcquireProjectile(), but there's no actor to hand back.
+	void Launch(TSubclassOf<AProjectileBase> ProjectileClass, const FVector& Location, const FRotator& Rotation, AActor* Owner);
+	int32 GetNumInFlight() const { return NumInFlight; }
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	/// Move every batch by DeltaTime. Called from Tick, or from every fixed step when the SimulationClock is on.
+	void UpdateBatches(float DeltaTime);
+	FSimulatedProjectileBatch& FindOrAddBatch(TSubclassOf<AProjectileBase> ProjectileClass);
+	/// Handle the hits from last frame's async traces.
+	void ReadTraces(FSimulatedProjectileBatch& Batch);
+	void Integrate(FSimulatedProjectileBatch& Batch, float DeltaTime);
+	/// Fuses, lifespans and the kill Z, then trace this frame's moves.
+	void UpdateProjectiles(FSimulatedProjectileBatch& Batch, float DeltaTime);
+	void UpdateInstances(FSimulatedProjectileBatch& Batch);
+
+	/// Same outcomes as AProjectileBase::OnHit(). Returns true if the projectile is gone (and Index now holds another one).
+	bool HandleHit(FSimulatedProjectileBatch& Batch, int32 Index, const FHitResult& Hit);
+	/// Same outcomes as AProjectileBase::DestroyProjectile(). Always removes the projectile.
+	void Explode(FSimulatedProjectileBatch& Batch, int32 Index);
+	void Remove(FSimulatedProjectileBatch& Batch, int32 Index);
+	/// Same cooldown as AProjectileBase's impact sounds, per projectile.
+	void PlayImpactSound(FSimulatedProjectileBatch& Batch, int32 Index, USoundBase* Sound, float Priority);
+	bool IsCosmetic() const { return GetWorld()->GetNetMode() == NM_Client; }
+
+	UPROPERTY()
+	TMap<UClass*, FSimulatedProjectileBatch> Batches;
+	/// Holds the instanced mesh components, since components need an actor.
+	UPROPERTY()
+	AActor* Renderer;
+
+	UPROPERTY()
+	UAudioEventSubsystem* AudioEvents;
+	UPROPERTY()
+	UEffectsSubsystem* Effects;
+	UPROPERTY()
+	UExplosionSubsystem* Explosions;
+	UPROPERTY()
+	UWeaponDefinitionSubsystem* Weapons;
+	UPROPERTY()
+	USceneQuerySubsystem* SceneQueries;
+
+	bool IsFixedStep = false;
+
+	int32 NumInFlight = 0;
+	/// True while some instances still need hiding after their projectiles are gone.
+	bool HasStaleInstances = false;
+
+	// Scratch space, kept around so we don't allocate every frame.
+	TArray<float> StartsX;
+	TArray<float> StartsY;
+	TArray<float> StartsZ;
+	TArray<FTransform> Transforms;
+};
@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SceneQuerySubsystem.h"
+
+#include "Engine/World.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+#define OUT
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<bool> CVarSceneQueriesAsync(
+	TEXT("ToonTanks.SceneQueries.Async"),
+	true,
+	TEXT("On: overlaps and traces run alongside the frame and report back at the start of the next one.\n")
+	TEXT("Off: they block the game thread and report back straight away."));
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.SceneQueries.Stats" in the console, once with Async on and once with it off, to compare.
+static FAutoConsoleCommandWithWorld SceneQueryStatsCommand(
+	TEXT("ToonTanks.SceneQueries.Stats"),
+	TEXT("Print game thread time and latency of sync vs async scene queries for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (USceneQuerySubsystem* SceneQueries = World ? World->GetSubsystem<USceneQuerySubsystem>() : nullptr) {
+			SceneQueries->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+bool USceneQuerySubsystem::IsAsyncEnabled()
+{
+	return CVarSceneQueriesAsync.GetValueOnGameThread();
+}
+
+// -------------------------------------------------------------------------------------------
+void USceneQuerySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	USimulationClockSubsystem* SimulationClock = Cast<USimulationClockSubsystem>(
+		Collection.InitializeDependency(USimulationClockSubsystem::StaticClass()));
+	IsFixedStep = SimulationClock && SimulationClock->IsFixedStep();
+}
+
+// -------------------------------------------------------------------------------------------
+void USceneQuerySubsystem::Deinitialize()
+{
+	// Whatever's still in flight gets dropped, the engine won't call back into us after this.
+	Pending.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+/// The SceneQueryWait scope only covers the query itself, the callback's work is timed by whoever did the asking.
+void USceneQuerySubsystem::RequestOverlap(const FVector& Center, float Radius, ECollisionChannel Channel,
+	FSceneOverlapCallback Callback)
+{
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(Radius);
+
+	if (!UsesAsync()) {
+		TArray<FOverlapResult> Overlaps;
+		{
+			TOONTANKS_SCOPE_CYCLE(SceneQueryWait);
+			const double StartSeconds = FPlatformTime::Seconds();
+			GetWorld()->OverlapMultiByChannel(OUT Overlaps, Center, FQuat::Identity, Channel, Sphere);
+			const double Seconds = FPlatformTime::Seconds() - StartSeconds;
+			RecordQuery(false, Seconds, Seconds, 0);
+		}
+		Callback(Overlaps);
+		return;
+	}
+
+	TOONTANKS_SCOPE_CYCLE(SceneQueryWait);
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	const uint32 UserData = NextUserData++;
+	FPendingSceneQuery& Query = Pending.Add(UserData);
+	Query.OnOverlap = MoveTemp(Callback);
+	Query.IssueSeconds = StartSeconds;
+	Query.IssueFrame = GFrameCounter;
+
+	FOverlapDelegate Delegate = FOverlapDelegate::CreateUObject(this, &USceneQuerySubsystem::OnOverlapDone);
+	GetWorld()->AsyncOverlapByChannel(
+		Center,
+		FQuat::Identity,
+		Channel,
+		Sphere,
+		FCollisionQueryParams::DefaultQueryParam,
+		FCollisionResponseParams::DefaultResponseParam,
+		&Delegate,
+		UserData
+		);
+	GameThreadSeconds[1] += FPlatformTime::Seconds() - StartSeconds;
+}
+
+// -------------------------------------------------------------------------------------------
+void USceneQuerySubsystem::RequestLineTrace(const FVector& Start, const FVector& End, ECollisionChannel Channel,
+	const FCollisionQueryParams& Params, FSceneTraceCallback Callback)
+{
+	if (!UsesAsync()) {
+		TArray<FHitResult> Hits;
+		{
+			TOONTANKS_SCOPE_CYCLE(SceneQueryWait);
+			const double StartSeconds = FPlatformTime::Seconds();
+			FHitResult Hit;
+			if (GetWorld()->LineTraceSingleByChannel(OUT Hit, Start, End, Channel, Params)) {
+				Hits.Add(Hit);
+			}
+			const double Seconds = FPlatformTime::Seconds() - StartSeconds;
+			RecordQuery(false, Seconds, Seconds, 0);
+		}
+		Callback(Hits);
+		return;
+	}
+
+	TOONTANKS_SCOPE_CYCLE(SceneQueryWait);
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	const uint32 UserData = NextUserData++;
+	FPendingSceneQuery& Query = Pending.Add(UserData);
+	Query.OnTrace = MoveTemp(Callback);
+	Query.IssueSeconds = StartSeconds;
+	Query.IssueFrame = GFrameCounter;
+
+	FTraceDelegate Delegate = FTraceDelegate::CreateUObject(this, &USceneQuerySubsystem::OnTraceDone);
+	GetWorld()->AsyncLineTraceByChannel(
+		EAsyncTraceType::Single,
+		Start,
+		End,
+		Channel,
+		Params,
+		FCollisionResponseParams::DefaultResponseParam,
+		&Delegate,
+		UserData
+		);
+	GameThreadSeconds[1] += FPlatformTime::Seconds() - StartSeconds;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called by the engine at the start of the frame after the request, on the game thread.
+void USceneQuerySubsystem::OnOverlapDone(const FTraceHandle& Handle, FOverlapDatum& Datum)
+{
+	FPendingSceneQuery Query;
+	if (TakePending(Datum.UserData, OUT Query) && Query.OnOverlap) {
+		Query.OnOverlap(Datum.OutOverlaps);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Called by the engine at the start of the frame after the request, on the game thread.
+void USceneQuerySubsystem::OnTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FPendingSceneQuery Query;
+	if (TakePending(Datum.UserData, OUT Query) && Query.OnTrace) {
+		Query.OnTrace(Datum.OutHits);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+bool USceneQuerySubsystem::TakePending(uint32 UserData, FPendingSceneQuery& OutPending)
+{
+	if (!Pending.RemoveAndCopyValue(UserData, OutPending)) {
+		return false;
+	}
+	RecordQuery(true, 0, FPlatformTime::Seconds() - OutPending.IssueSeconds, GFrameCounter - OutPending.IssueFrame);
+	return true;
+}
+
+// -------------------------------------------------------------------------------------------
+void USceneQuerySubsystem::RecordQuery(bool IsAsync, double GameThreadTime, double Latency, uint64 Frames)
+{
+	const int32 Mode = IsAsync ? 1 : 0;
+	NumQueries[Mode]++;
+	GameThreadSeconds[Mode] += GameThreadTime;
+	LatencySeconds[Mode] += Latency;
+	LatencyFrames[Mode] += Frames;
+
+	if (IsAsync) {
+		TOONTANKS_COUNT(SceneQueriesAsync, 1);
+	}
+	else {
+		TOONTANKS_COUNT(SceneQueriesSync, 1);
+	}
+	CSV_CUSTOM_STAT(ToonTanks, SceneQueryLatencyMs, static_cast<float>(Latency * 1000.0), ECsvCustomStatOp::Max);
+}
+
+// -------------------------------------------------------------------------------------------
+void USceneQuerySubsystem::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Scene queries: async is %s, %d still in flight"),
+		UsesAsync() ? TEXT("on") : TEXT("off"), Pending.Num());
+
+	const TCHAR* ModeNames[2] = {TEXT("sync"), TEXT("async")};
+	for (int32 Mode = 0; Mode < 2; Mode++) {
+		const double Num = FMath::Max(NumQueries[Mode], 1);
+		UE_LOG(LogTemp, Log, TEXT("  %-5s: %d queries, game thread %.3f ms avg, latency %.3f ms / %.2f frames avg"),
+			ModeNames[Mode],
+			NumQueries[Mode],
+			GameThreadSeconds[Mode] * 1000.0 / Num,
+			LatencySeconds[Mode] * 1000.0 / Num,
+			LatencyFrames[Mode] / Num);
+	}
+}
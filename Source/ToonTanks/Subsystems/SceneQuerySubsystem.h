@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+
+#include "SceneQuerySubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+/// Called with the results of a RequestOverlap().
+using FSceneOverlapCallback = TFunction<void(const TArray<FOverlapResult>& Overlaps)>;
+/// Called with the results of a RequestLineTrace() (just the blocking hit, if there was one).
+using FSceneTraceCallback = TFunction<void(const TArray<FHitResult>& Hits)>;
+
+// -------------------------------------------------------------------------------------------
+/// A query we've handed to the physics scene and haven't heard back about yet.
+struct FPendingSceneQuery
+{
+	FSceneOverlapCallback OnOverlap;
+	FSceneTraceCallback OnTrace;
+	double IssueSeconds = 0;
+	uint64 IssueFrame = 0;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Request/response scene queries (overlaps and line traces). \n
+ * With ToonTanks.SceneQueries.Async on (the default), queries go to the engine's async trace
+ * (AsyncOverlapByChannel / AsyncLineTraceByChannel), which runs them alongside the rest of the frame,
+ * and the callback gets the results at the start of the next frame. The game thread never waits on physics. \n
+ * With it off, the query runs right there and the callback is called before the request returns, same as
+ * the plain blocking calls. "ToonTanks.SceneQueries.Stats" compares game thread time and latency of the two. \n
+ * On a fixed timestep (see USimulationClockSubsystem) queries are always blocking, since async results
+ * come back a frame later, and how many steps that is depends on the frame rate.
+ * Callbacks can come after whoever asked is gone, so capture a TWeakObjectPtr, not a raw pointer.
+ */
+UCLASS()
+class TOONTANKS_API USceneQuerySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// Every object on Channel within Radius of Center.
+	void RequestOverlap(const FVector& Center, float Radius, ECollisionChannel Channel, FSceneOverlapCallback Callback);
+	/// The first blocking hit on Channel between Start and End (Hits is empty if there wasn't one).
+	void RequestLineTrace(const FVector& Start, const FVector& End, ECollisionChannel Channel,
+		const FCollisionQueryParams& Params, FSceneTraceCallback Callback);
+
+	void LogStats() const;
+	/// ToonTanks.SceneQueries.Async, for anything else that picks between sync and async queries.
+	static bool IsAsyncEnabled();
+	/// Whether this World's queries go async: IsAsyncEnabled(), and not on a fixed timestep.
+	bool UsesAsync() const { return !IsFixedStep && IsAsyncEnabled(); }
+
+private:
+	// ---------------------------------------------------------
+	void OnOverlapDone(const FTraceHandle& Handle, FOverlapDatum& Datum);
+	void OnTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+	/// Pull the pending query for UserData out, and add its latency to the stats.
+	bool TakePending(uint32 UserData, FPendingSceneQuery& OutPending);
+	void RecordQuery(bool IsAsync, double GameThreadTime, double Latency, uint64 Frames);
+
+	/// Keyed by the UserData we gave the engine, since that's all we get back with the results.
+	TMap<uint32, FPendingSceneQuery> Pending;
+	uint32 NextUserData = 1;
+	bool IsFixedStep = false;
+
+	// Totals since the World started, per mode (0 = sync, 1 = async).
+	int32 NumQueries[2] = {0, 0};
+	/// Time the game thread spent inside RequestX() calls.
+	double GameThreadSeconds[2] = {0, 0};
+	/// Time from the request to the callback.
+	double LatencySeconds[2] = {0, 0};
+	uint64 LatencyFrames[2] = {0, 0};
+};
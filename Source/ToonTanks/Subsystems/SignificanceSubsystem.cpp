@@ -0,0 +1,339 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SignificanceSubsystem.h"
+
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "ToonTanks/Actors/ProjectileBase.h"
+#include "ToonTanks/Pawns/PawnBase.h"
+#include "ToonTanks/Subsystems/AudioEventSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+#define OUT
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<bool> CVarSignificanceEnabled(
+	TEXT("ToonTanks.Significance.Enabled"),
+	true,
+	TEXT("Off: everything is High significance, at full fidelity no matter how far away it is."));
+
+static TAutoConsoleVariable<float> CVarSignificanceHighDistance(
+	TEXT("ToonTanks.Significance.HighDistance"),
+	3000.f,
+	TEXT("On screen things closer than this to a player's view are High significance."));
+
+static TAutoConsoleVariable<float> CVarSignificanceMediumDistance(
+	TEXT("ToonTanks.Significance.MediumDistance"),
+	6000.f,
+	TEXT("On screen things closer than this (and further than HighDistance) are Medium significance."));
+
+static TAutoConsoleVariable<float> CVarSignificanceLowDistance(
+	TEXT("ToonTanks.Significance.LowDistance"),
+	12000.f,
+	TEXT("On screen things closer than this (and further than MediumDistance) are Low significance. Further still is Dormant."));
+
+static TAutoConsoleVariable<float> CVarSignificanceOffscreenScale(
+	TEXT("ToonTanks.Significance.OffscreenScale"),
+	2.f,
+	TEXT("Things off screen count as this many times further away."));
+
+static TAutoConsoleVariable<float> CVarSignificanceUpdateInterval(
+	TEXT("ToonTanks.Significance.UpdateInterval"),
+	0.25f,
+	TEXT("Seconds between re-scoring every pawn and projectile."));
+
+/// Type "ToonTanks.Significance.Stats" in the console to see how much of the battle is far enough away to be cheap.
+static FAutoConsoleCommandWithWorld SignificanceStatsCommand(
+	TEXT("ToonTanks.Significance.Stats"),
+	TEXT("Print how many pawns and projectiles are in each significance tier, and what got skipped because of it."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (USignificanceSubsystem* Significance = World ? World->GetSubsystem<USignificanceSubsystem>() : nullptr) {
+			Significance->LogStats();
+		}
+	}));
+
+/// Anything this close to a viewer counts as on screen, even if it's just behind the camera.
+static constexpr float AlwaysOnScreenDistance = 1000;
+/// Extra degrees on top of half the FOV, so things just off the edge of the screen still count as on it.
+static constexpr float ScreenMarginDegrees = 10;
+/// Remote players' FOV, since the server doesn't know what they've set it to.
+static constexpr float DefaultFOV = 90;
+
+static const TCHAR* const TierNames[NumSignificanceTiers] = {TEXT("High"), TEXT("Medium"), TEXT("Low"), TEXT("Dormant")};
+static constexpr float TickIntervals[NumSignificanceTiers] = {0, 0, 1 / 20.f, 1 / 5.f};
+/// SetForcedLodModel() is one more than the LOD index, and gets clamped to the mesh's lowest LOD.
+static constexpr int32 ForcedLods[NumSignificanceTiers] = {0, 0, 2, 8};
+
+// -------------------------------------------------------------------------------------------
+void USignificanceSubsystem::Deinitialize()
+{
+	Pawns.Empty();
+	PawnTiers.Empty();
+	Projectiles.Empty();
+	ProjectileTiers.Empty();
+	Viewers.Empty();
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void USignificanceSubsystem::Tick(float DeltaTime)
+{
+	TimeUntilUpdate -= DeltaTime;
+	if (TimeUntilUpdate <= 0) {
+		TimeUntilUpdate = CVarSignificanceUpdateInterval.GetValueOnGameThread();
+		UpdateViewers();
+		UpdateTiers();
+	}
+	PublishStats();
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType USignificanceSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Always, even with nothing registered, since sounds and effects ask about locations.
+bool USignificanceSubsystem::IsTickable() const
+{
+	return true;
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* USignificanceSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId USignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USignificanceSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+void USignificanceSubsystem::RegisterPawn(APawnBase* Pawn)
+{
+	if (!Pawn || Pawn->SignificanceIndex != INDEX_NONE) {
+		return;
+	}
+
+	const ESignificanceTier Tier = GetTierAt(Pawn->GetActorLocation());
+	Pawn->SignificanceIndex = Pawns.Add(Pawn);
+	PawnTiers.Add(Tier);
+	Pawn->SetSignificanceTier(Tier);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Swap the last pawn into our slot, so the arrays stay packed.
+void USignificanceSubsystem::UnregisterPawn(APawnBase* Pawn)
+{
+	if (!Pawn || !Pawns.IsValidIndex(Pawn->SignificanceIndex) || Pawns[Pawn->SignificanceIndex] != Pawn) {
+		return;
+	}
+
+	const int32 Index = Pawn->SignificanceIndex;
+	Pawns.RemoveAtSwap(Index, 1, false);
+	PawnTiers.RemoveAtSwap(Index, 1, false);
+	if (Pawns.IsValidIndex(Index) && Pawns[Index]) {
+		Pawns[Index]->SignificanceIndex = Index;
+	}
+	Pawn->SignificanceIndex = INDEX_NONE;
+}
+
+// -------------------------------------------------------------------------------------------
+void USignificanceSubsystem::RegisterProjectile(AProjectileBase* Projectile)
+{
+	if (!Projectile || Projectile->SignificanceIndex != INDEX_NONE) {
+		return;
+	}
+
+	const ESignificanceTier Tier = GetTierAt(Projectile->GetActorLocation());
+	Projectile->SignificanceIndex = Projectiles.Add(Projectile);
+	ProjectileTiers.Add(Tier);
+	Projectile->SetSignificanceTier(Tier);
+}
+
+// -------------------------------------------------------------------------------------------
+void USignificanceSubsystem::UnregisterProjectile(AProjectileBase* Projectile)
+{
+	if (!Projectile || !Projectiles.IsValidIndex(Projectile->SignificanceIndex)
+		|| Projectiles[Projectile->SignificanceIndex] != Projectile) {
+		return;
+	}
+
+	const int32 Index = Projectile->SignificanceIndex;
+	Projectiles.RemoveAtSwap(Index, 1, false);
+	ProjectileTiers.RemoveAtSwap(Index, 1, false);
+	if (Projectiles.IsValidIndex(Index) && Projectiles[Index]) {
+		Projectiles[Index]->SignificanceIndex = Index;
+	}
+	Projectile->SignificanceIndex = INDEX_NONE;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Distance to the closest viewer, squared, with off screen counting as further away.
+ESignificanceTier USignificanceSubsystem::GetTierAt(const FVector& Location) const
+{
+	if (Viewers.Num() == 0 || !CVarSignificanceEnabled.GetValueOnGameThread()) {
+		return ESignificanceTier::High;
+	}
+
+	const float OffscreenScaleSquared = FMath::Square(CVarSignificanceOffscreenScale.GetValueOnGameThread());
+	float ClosestSquared = BIG_NUMBER;
+	for (const FSignificanceViewer& Viewer : Viewers) {
+		const FVector ToTarget = Location - Viewer.Location;
+		float DistanceSquared = ToTarget.SizeSquared();
+		// Same as comparing the angle to half the FOV, without normalizing ToTarget.
+		const bool IsOnScreen = DistanceSquared < FMath::Square(AlwaysOnScreenDistance)
+			|| (ToTarget | Viewer.Forward) >= Viewer.CosHalfFOV * FMath::Sqrt(DistanceSquared);
+		if (!IsOnScreen) {
+			DistanceSquared *= OffscreenScaleSquared;
+		}
+		ClosestSquared = FMath::Min(ClosestSquared, DistanceSquared);
+	}
+
+	if (ClosestSquared < FMath::Square(CVarSignificanceHighDistance.GetValueOnGameThread())) {
+		return ESignificanceTier::High;
+	}
+	if (ClosestSquared < FMath::Square(CVarSignificanceMediumDistance.GetValueOnGameThread())) {
+		return ESignificanceTier::Medium;
+	}
+	if (ClosestSquared < FMath::Square(CVarSignificanceLowDistance.GetValueOnGameThread())) {
+		return ESignificanceTier::Low;
+	}
+	return ESignificanceTier::Dormant;
+}
+
+// -------------------------------------------------------------------------------------------
+bool USignificanceSubsystem::ShouldSpawnEffect(const FVector& Location)
+{
+	const ESignificanceTier Tier = GetTierAt(Location);
+	if (Tier >= ESignificanceTier::Low) {
+		NumEffectsSkipped[static_cast<int32>(Tier)]++;
+		return false;
+	}
+	return true;
+}
+
+// -------------------------------------------------------------------------------------------
+bool USignificanceSubsystem::ShouldPlaySound(const FVector& Location, float Priority)
+{
+	const ESignificanceTier Tier = GetTierAt(Location);
+	const bool ShouldPlay = Tier < ESignificanceTier::Low
+		|| (Tier == ESignificanceTier::Low && Priority >= ToonTanksSoundPriority::Explosion);
+	if (!ShouldPlay) {
+		NumSoundsSkipped[static_cast<int32>(Tier)]++;
+	}
+	return ShouldPlay;
+}
+
+// -------------------------------------------------------------------------------------------
+float USignificanceSubsystem::GetTickInterval(ESignificanceTier Tier)
+{
+	return TickIntervals[static_cast<int32>(Tier)];
+}
+
+// -------------------------------------------------------------------------------------------
+int32 USignificanceSubsystem::GetForcedLod(ESignificanceTier Tier)
+{
+	return ForcedLods[static_cast<int32>(Tier)];
+}
+
+// -------------------------------------------------------------------------------------------
+/// Every player's view on a server (remote players need the battle around them simulated properly too),
+/// just the local ones anywhere else.
+void USignificanceSubsystem::UpdateViewers()
+{
+	Viewers.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It) {
+		APlayerController* PlayerController = It->Get();
+		if (!PlayerController) {
+			continue;
+		}
+
+		FVector Location;
+		FRotator Rotation;
+		PlayerController->GetPlayerViewPoint(OUT Location, OUT Rotation);
+
+		const APlayerCameraManager* Camera = PlayerController->PlayerCameraManager;
+		const float FOV = Camera && PlayerController->IsLocalController() ? Camera->GetFOVAngle() : DefaultFOV;
+		const float HalfFOV = FMath::Min(FOV * 0.5f + ScreenMarginDegrees, 89.f);
+		Viewers.Add({Location, Rotation.Vector(), FMath::Cos(FMath::DegreesToRadians(HalfFOV))});
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Re-score everything, and only tell the ones whose tier changed.
+void USignificanceSubsystem::UpdateTiers()
+{
+	TOONTANKS_SCOPE_CYCLE(Significance);
+
+	FMemory::Memzero(NumPawnsPerTier);
+	FMemory::Memzero(NumProjectilesPerTier);
+
+	for (int32 Index = 0; Index < Pawns.Num(); Index++) {
+		APawnBase* Pawn = Pawns[Index];
+		if (!Pawn) {
+			continue;
+		}
+		const ESignificanceTier Tier = GetTierAt(Pawn->GetActorLocation());
+		if (Tier != PawnTiers[Index]) {
+			PawnTiers[Index] = Tier;
+			Pawn->SetSignificanceTier(Tier);
+		}
+		NumPawnsPerTier[static_cast<int32>(Tier)]++;
+	}
+
+	for (int32 Index = 0; Index < Projectiles.Num(); Index++) {
+		AProjectileBase* Projectile = Projectiles[Index];
+		if (!Projectile) {
+			continue;
+		}
+		const ESignificanceTier Tier = GetTierAt(Projectile->GetActorLocation());
+		if (Tier != ProjectileTiers[Index]) {
+			ProjectileTiers[Index] = Tier;
+			Projectile->SetSignificanceTier(Tier);
+		}
+		NumProjectilesPerTier[static_cast<int32>(Tier)]++;
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Pawns and projectiles per tier, every frame so the CSV has a value on every row.
+void USignificanceSubsystem::PublishStats() const
+{
+	const int32 NumHigh = NumPawnsPerTier[0] + NumProjectilesPerTier[0];
+	const int32 NumMedium = NumPawnsPerTier[1] + NumProjectilesPerTier[1];
+	const int32 NumLow = NumPawnsPerTier[2] + NumProjectilesPerTier[2];
+	const int32 NumDormant = NumPawnsPerTier[3] + NumProjectilesPerTier[3];
+
+	SET_DWORD_STAT(STAT_ToonTanks_SignificanceHigh, NumHigh);
+	SET_DWORD_STAT(STAT_ToonTanks_SignificanceMedium, NumMedium);
+	SET_DWORD_STAT(STAT_ToonTanks_SignificanceLow, NumLow);
+	SET_DWORD_STAT(STAT_ToonTanks_SignificanceDormant, NumDormant);
+	CSV_CUSTOM_STAT(ToonTanks, SignificanceHigh, NumHigh, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ToonTanks, SignificanceMedium, NumMedium, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ToonTanks, SignificanceLow, NumLow, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(ToonTanks, SignificanceDormant, NumDormant, ECsvCustomStatOp::Set);
+}
+
+// -------------------------------------------------------------------------------------------
+void USignificanceSubsystem::LogStats() const
+{
+	UE_LOG(LogTemp, Display, TEXT("Significance: %s, %d viewers, %d pawns, %d projectiles."),
+		CVarSignificanceEnabled.GetValueOnGameThread() ? TEXT("on") : TEXT("off"),
+		Viewers.Num(), Pawns.Num(), Projectiles.Num());
+	for (int32 Tier = 0; Tier < NumSignificanceTiers; Tier++) {
+		UE_LOG(LogTemp, Display, TEXT("  %-8s %4d pawns, %4d projectiles, tick every %.2fs, %d effects and %d sounds skipped."),
+			TierNames[Tier],
+			NumPawnsPerTier[Tier],
+			NumProjectilesPerTier[Tier],
+			TickIntervals[Tier],
+			NumEffectsSkipped[Tier],
+			NumSoundsSkipped[Tier]);
+	}
+}
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+
+#include "SignificanceSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class APawnBase;
+class AProjectileBase;
+
+// -------------------------------------------------------------------------------------------
+/// How much something matters to whoever's watching. Lower is more significant.
+enum class ESignificanceTier : uint8
+{
+	/// Close to a player, or on screen not too far out: everything at full fidelity.
+	High,
+	/// Further out, or close but behind the camera: still full fidelity, just first in line to drop.
+	Medium,
+	/// Far away: slower ticks, low mesh LOD, no small sounds or particles, approximated explosion impulses.
+	Low,
+	/// Nobody can possibly tell: slowest ticks, lowest LOD, no sounds, particles or explosion impulses at all.
+	Dormant,
+};
+constexpr int32 NumSignificanceTiers = 4;
+
+// -------------------------------------------------------------------------------------------
+/// Where someone is watching from: a local camera, or (on a server) a remote player's view.
+struct FSignificanceViewer
+{
+	FVector Location;
+	FVector Forward;
+	float CosHalfFOV;
+};
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Scores every APawnBase and in-flight AProjectileBase by distance to the nearest player's view
+ * (with off screen things counting as further away), and sorts them into an ESignificanceTier. \n
+ * Tiers are re-scored a few times a second, and pawns and projectiles are only told when their tier changes,
+ * so they can change their tick interval and mesh LOD. Sounds, particles and explosion impulses don't have
+ * an actor to tell, so the Audio, Effects and Explosion subsystems ask GetTierAt() for their location instead. \n
+ * Without any players (headless benchmarks), or with ToonTanks.Significance.Enabled off, everything is High.
+ */
+UCLASS()
+class TOONTANKS_API USignificanceSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Pawns register in BeginPlay and unregister in EndPlay. They get their first tier straight away.
+	void RegisterPawn(APawnBase* Pawn);
+	void UnregisterPawn(APawnBase* Pawn);
+	/// Pooled projectiles register when they launch and unregister when they go back to the pool.
+	void RegisterProjectile(AProjectileBase* Projectile);
+	void UnregisterProjectile(AProjectileBase* Projectile);
+
+	/// The tier of whatever is at Location, as of the last update.
+	ESignificanceTier GetTierAt(const FVector& Location) const;
+	/// Particles only spawn at High and Medium.
+	bool ShouldSpawnEffect(const FVector& Location);
+	/// Low only gets the big sounds (explosions and deaths), Dormant gets none.
+	bool ShouldPlaySound(const FVector& Location, float Priority);
+
+	/// Seconds between ticks at Tier (0 is every frame).
+	static float GetTickInterval(ESignificanceTier Tier);
+	/// What to pass SetForcedLodModel() at Tier (0 lets the engine pick by screen size).
+	static int32 GetForcedLod(ESignificanceTier Tier);
+
+	void LogStats() const;
+
+private:
+	// ---------------------------------------------------------
+	void UpdateViewers();
+	void UpdateTiers();
+	void PublishStats() const;
+
+	// Pawns and projectiles keep their index into these (SignificanceIndex), same as the TurretManagerSubsystem.
+	UPROPERTY()
+	TArray<APawnBase*> Pawns;
+	TArray<ESignificanceTier> PawnTiers;
+	UPROPERTY()
+	TArray<AProjectileBase*> Projectiles;
+	TArray<ESignificanceTier> ProjectileTiers;
+
+	TArray<FSignificanceViewer> Viewers;
+	float TimeUntilUpdate = 0;
+
+	// As of the last update.
+	int32 NumPawnsPerTier[NumSignificanceTiers] = {0, 0, 0, 0};
+	int32 NumProjectilesPerTier[NumSignificanceTiers] = {0, 0, 0, 0};
+	// Totals since the World started.
+	int32 NumEffectsSkipped[NumSignificanceTiers] = {0, 0, 0, 0};
+	int32 NumSoundsSkipped[NumSignificanceTiers] = {0, 0, 0, 0};
+};
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SimulationClockSubsystem.h"
+
+#include "Engine/World.h"
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<float> CVarSimFixedStepHz(
+	TEXT("ToonTanks.Sim.FixedStepHz"),
+	0.f,
+	TEXT("Fixed simulation steps per second for tank movement, turret aim, firing, projectiles and explosions. 0 = off (per-frame).\n")
+	TEXT("Read when a World starts, so set it before loading the map (or use -FixedStepHz= on the command line)."));
+
+static TAutoConsoleVariable<int32> CVarSimStepsPerFrame(
+	TEXT("ToonTanks.Sim.StepsPerFrame"),
+	0,
+	TEXT("If > 0, run exactly this many fixed steps every frame no matter how long the frame took.\n")
+	TEXT("Used to run the simulation faster than real time on headless runs."));
+
+static TAutoConsoleVariable<int32> CVarSimMaxStepsPerFrame(
+	TEXT("ToonTanks.Sim.MaxStepsPerFrame"),
+	8,
+	TEXT("Most fixed steps to catch up on in one frame, so a long hitch doesn't snowball into more hitches."));
+
+// -------------------------------------------------------------------------------------------
+void USimulationClockSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	float FixedStepHz = CVarSimFixedStepHz.GetValueOnGameThread();
+	FParse::Value(FCommandLine::Get(), TEXT("FixedStepHz="), FixedStepHz);
+	StepSeconds = FixedStepHz > 0 ? 1.f / FixedStepHz : 0.f;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Turn this frame's time into whole steps. Leftover time carries over to the next frame.
+void USimulationClockSubsystem::Tick(float DeltaTime)
+{
+	const int32 StepsPerFrame = CVarSimStepsPerFrame.GetValueOnGameThread();
+	if (StepsPerFrame > 0) {
+		for (int32 Index = 0; Index < StepsPerFrame; Index++) {
+			Step();
+		}
+		return;
+	}
+
+	const int32 MaxSteps = CVarSimMaxStepsPerFrame.GetValueOnGameThread();
+	int32 Steps = 0;
+	Accumulator += DeltaTime;
+	while (Accumulator >= StepSeconds && Steps < MaxSteps) {
+		Accumulator -= StepSeconds;
+		Step();
+		Steps++;
+	}
+
+	// We fell too far behind, drop the backlog instead of trying to catch up next frame too.
+	if (Steps == MaxSteps) {
+		Accumulator = FMath::Min(Accumulator, StepSeconds);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType USimulationClockSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+bool USimulationClockSubsystem::IsTickable() const
+{
+	return IsFixedStep();
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* USimulationClockSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId USimulationClockSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USimulationClockSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+double USimulationClockSubsystem::GetGameplayTime(const UWorld* World)
+{
+	const USimulationClockSubsystem* SimulationClock = World->GetSubsystem<USimulationClockSubsystem>();
+	return SimulationClock && SimulationClock->IsFixedStep() ? SimulationClock->GetSimulatedTime() : World->GetTimeSeconds();
+}
+
+// -------------------------------------------------------------------------------------------
+void USimulationClockSubsystem::Step()
+{
+	StepCount++;
+	OnStep.Broadcast(StepSeconds);
+	OnPostStep.Broadcast(StepSeconds);
+}
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+
+#include "SimulationClockSubsystem.generated.h"
+
+/// Fired once per fixed simulation step, with the step length in seconds.
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnSimulationStep, float);
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Opt-in fixed timestep for gameplay. \n
+ * When enabled (-FixedStepHz=60 on the command line, or ToonTanks.Sim.FixedStepHz before the map loads),
+ * tank movement, turret aim and fire cadence, projectile flight (pooled and lightweight), grenade fuses
+ * and lifespans all advance in whole steps from OnStep instead of per-frame DeltaTime and FTimerManager timers.
+ * The explosions a step set off are resolved in OnPostStep, with blocking scene queries, so their damage
+ * lands in that same step. A match then plays out the same at any frame rate. \n
+ * ToonTanks.Sim.StepsPerFrame > 0 ignores real time and runs that many steps every frame,
+ * which lets headless runs simulate faster than real time. \n
+ * Physics bodies (crates pushed around by explosions) still move with the frame, since the physics scene
+ * steps once per frame. Nothing reads them for gameplay, but a tank can bump into one, so levels full of
+ * loose physics props aren't bit for bit repeatable. Sounds and particles are per frame too, they're just looks.
+ */
+UCLASS()
+class TOONTANKS_API USimulationClockSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Whether gameplay should run off OnStep instead of Tick/timers. Decided once, when the World starts.
+	bool IsFixedStep() const { return StepSeconds > 0; }
+	float GetStepSeconds() const { return StepSeconds; }
+	int64 GetStepCount() const { return StepCount; }
+	/// Seconds of gameplay simulated so far (StepCount * StepSeconds).
+	double GetSimulatedTime() const { return StepCount * static_cast<double>(StepSeconds); }
+	/// GetSimulatedTime() on a fixed timestep, World's game time otherwise. For gameplay timing windows.
+	static double GetGameplayTime(const UWorld* World);
+
+	/// Every fixed step: movement, aim, firing and projectiles.
+	FOnSimulationStep OnStep;
+	/// Right after OnStep, for resolving what the step set off (explosions).
+	FOnSimulationStep OnPostStep;
+
+private:
+	// ---------------------------------------------------------
+	void Step();
+
+	float StepSeconds = 0;
+	float Accumulator = 0;
+	int64 StepCount = 0;
+};
@@ -0,0 +1,491 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TurretManagerSubsystem.h"
+
+#include "Async/ParallelFor.h"
+#include "ToonTanks/Pawns/PawnTank.h"
+#include "ToonTanks/Pawns/PawnTurret.h"
+#include "ToonTanks/Subsystems/BallisticsSubsystem.h"
+#include "ToonTanks/Subsystems/PawnSpatialGridSubsystem.h"
+#include "ToonTanks/Subsystems/SimulationClockSubsystem.h"
+#include "ToonTanks/ToonTanksStats.h"
+#define OUT
+
+// -------------------------------------------------------------------------------------------
+static TAutoConsoleVariable<float> CVarTurretThinkBudgetUs(
+	TEXT("ToonTanks.Turrets.ThinkBudgetUs"),
+	200.f,
+	TEXT("Microseconds per frame (or fixed step) turrets get for picking targets. Whatever's left over waits for the next frame."));
+
+static TAutoConsoleVariable<int32> CVarTurretThinksPerStep(
+	TEXT("ToonTanks.Turrets.ThinksPerStep"),
+	32,
+	TEXT("On a fixed timestep, the most target picks per step. Used instead of ThinkBudgetUs there,\n")
+	TEXT("since a time budget would make which turrets think depend on how busy the machine is."));
+
+static TAutoConsoleVariable<int32> CVarTurretThinkMinFrames(
+	TEXT("ToonTanks.Turrets.ThinkMinFrames"),
+	2,
+	TEXT("Frames between target picks for a turret with a tank right on top of it."));
+
+static TAutoConsoleVariable<int32> CVarTurretThinkMaxFrames(
+	TEXT("ToonTanks.Turrets.ThinkMaxFrames"),
+	15,
+	TEXT("Frames between target picks for a turret with no tank in range (and how long a tank can go unnoticed)."));
+
+static TAutoConsoleVariable<bool> CVarTurretLeadTargets(
+	TEXT("ToonTanks.Turrets.LeadTargets"),
+	true,
+	TEXT("Turrets lob their shots at where the target will be when they land (with the projectile's ballistic table).\n")
+	TEXT("Off: aim straight at the target, and fire however the turret's ProjectileSpawnPoint is set up."));
+
+static TAutoConsoleVariable<float> CVarTurretMinYawChange(
+	TEXT("ToonTanks.Turrets.MinYawChange"),
+	0.1f,
+	TEXT("Degrees a turret has to turn before we move its mesh. Anything less skips the transform update."));
+
+static TAutoConsoleVariable<float> CVarTurretFireConeDegrees(
+	TEXT("ToonTanks.Turrets.FireConeDegrees"),
+	5.f,
+	TEXT("Turrets hold fire until they've turned to within this many degrees of their aim (target, or where it's going to be)."));
+
+static TAutoConsoleVariable<int32> CVarTurretParallelAimMin(
+	TEXT("ToonTanks.Turrets.ParallelAimMin"),
+	64,
+	TEXT("Aim on worker threads when there are at least this many turrets. Fewer aren't worth the task overhead."));
+
+// -------------------------------------------------------------------------------------------
+void UTurretManagerSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// With a fixed timestep, aim in the simulation steps. We bind before any turret spawns,
+	// so within a step the aim is always updated before the turrets decide whether to fire.
+	USimulationClockSubsystem* SimulationClock = Cast<USimulationClockSubsystem>(
+		Collection.InitializeDependency(USimulationClockSubsystem::StaticClass()));
+	if (SimulationClock && SimulationClock->IsFixedStep()) {
+		IsFixedStep = true;
+		SimulationClock->OnStep.AddUObject(this, &UTurretManagerSubsystem::UpdateTurrets);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+void UTurretManagerSubsystem::Deinitialize()
+{
+	for (APawnTurret* Turret : Turrets) {
+		if (Turret) {
+			Turret->ManagerIndex = INDEX_NONE;
+		}
+	}
+	Turrets.Empty();
+	Targets.Empty();
+	PositionsX.Empty();
+	PositionsY.Empty();
+	PositionsZ.Empty();
+	ThreatRangesSquared.Empty();
+	Yaws.Empty();
+	AppliedYaws.Empty();
+	TurnRates.Empty();
+	LaunchPitches.Empty();
+	InRange.Empty();
+	OnTarget.Empty();
+	Awake.Empty();
+	TargetPolicies.Empty();
+	TargetsX.Empty();
+	TargetsY.Empty();
+	TargetsZ.Empty();
+	HasTarget.Empty();
+	TargetVelocitiesX.Empty();
+	TargetVelocitiesY.Empty();
+	NextThinkFrames.Empty();
+	MuzzlesZ.Empty();
+	MuzzleForwards.Empty();
+	MuzzleRights.Empty();
+	BallisticTables.Empty();
+	Candidates.Empty();
+
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+void UTurretManagerSubsystem::Tick(float DeltaTime)
+{
+	if (!IsFixedStep) {
+		UpdateTurrets(DeltaTime);
+	}
+}
+
+// -------------------------------------------------------------------------------------------
+/// Pick targets for this frame's slice of turrets, then aim every turret at its target.
+void UTurretManagerSubsystem::UpdateTurrets(float DeltaTime)
+{
+	TOONTANKS_SCOPE_CYCLE(TurretUpdate);
+
+	// Clients get turret yaw replicated, and never fire, so there's nothing to do there.
+	if (GetWorld()->GetNetMode() == NM_Client) {
+		return;
+	}
+
+	UPawnSpatialGridSubsystem* SpatialGrid = GetWorld()->GetSubsystem<UPawnSpatialGridSubsystem>();
+	if (!SpatialGrid) {
+		return;
+	}
+
+	ThinkWithinBudget(SpatialGrid);
+	UpdateAim(SpatialGrid, DeltaTime);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Round robin over the turrets, thinking for the ones that are due, until we run out of budget or turrets.
+/// Turrets that didn't get their turn stay due, and the next frame picks up where we stopped.
+/// On a fixed timestep the budget is a number of thinks, so every run picks the same targets on the same steps.
+void UTurretManagerSubsystem::ThinkWithinBudget(UPawnSpatialGridSubsystem* SpatialGrid)
+{
+	ThinkFrame++;
+
+	const int32 Num = Turrets.Num();
+	const double BudgetSeconds = CVarTurretThinkBudgetUs.GetValueOnGameThread() / 1000000.0;
+	const uint32 BudgetCycles = static_cast<uint32>(BudgetSeconds / FPlatformTime::GetSecondsPerCycle());
+	const uint32 StartCycles = FPlatformTime::Cycles();
+	const int32 MaxThinks = IsFixedStep ? FMath::Max(CVarTurretThinksPerStep.GetValueOnGameThread(), 1) : MAX_int32;
+	int32 NumThinks = 0;
+
+	for (int32 Visited = 0; Visited < Num; Visited++) {
+		if (ThinkCursor >= Num) {
+			ThinkCursor = 0;
+		}
+		const int32 Index = ThinkCursor++;
+		if (NextThinkFrames[Index] > ThinkFrame) {
+			continue;
+		}
+
+		SelectTarget(Index, SpatialGrid);
+		NumThinks++;
+		if (NumThinks >= MaxThinks || (!IsFixedStep && FPlatformTime::Cycles() - StartCycles >= BudgetCycles)) {
+			break;
+		}
+	}
+
+	TOONTANKS_COUNT(TurretThinks, NumThinks);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Ask the spatial grid for everything in range, and keep the tank that best fits the turret's TargetPolicy.
+/// Ties (and Nearest) go to the closest tank. The closer the nearest tank, the sooner we think again.
+void UTurretManagerSubsystem::SelectTarget(int32 Index, UPawnSpatialGridSubsystem* SpatialGrid)
+{
+	const FVector TurretLocation(PositionsX[Index], PositionsY[Index], PositionsZ[Index]);
+	const ETurretTargetPolicy Policy = static_cast<ETurretTargetPolicy>(TargetPolicies[Index]);
+
+	Candidates.Reset();
+	SpatialGrid->QueryPawnsInRadius(TurretLocation, FMath::Sqrt(ThreatRangesSquared[Index]), OUT Candidates);
+
+	APawnTank* Best = nullptr;
+	float BestScore = 0;
+	float BestDistanceSquared = 0;
+	float NearestDistanceSquared = ThreatRangesSquared[Index];
+
+	for (APawnBase* Candidate : Candidates) {
+		APawnTank* Tank = Cast<APawnTank>(Candidate);
+		if (!Tank || !Tank->IsPlayerAlive()) {
+			continue;
+		}
+
+		const FVector ToTurret = TurretLocation - Tank->GetActorLocation();
+		const float DistanceSquared = ToTurret.SizeSquared();
+		NearestDistanceSquared = FMath::Min(NearestDistanceSquared, DistanceSquared);
+
+		// Higher is better.
+		float Score = 0;
+		switch (Policy) {
+			case ETurretTargetPolicy::LowestHealth:
+				Score = -Tank->GetHealth();
+				break;
+			case ETurretTargetPolicy::MostThreatening:
+				// How straight their turret is pointing at us: 1 dead on, 0 sideways, -1 facing away.
+				Score = FVector::DotProduct(Tank->GetAimDirection(), ToTurret.GetSafeNormal());
+				break;
+			default:
+				break;
+		}
+
+		const bool IsBetter = !Best || Score > BestScore || (Score == BestScore && DistanceSquared < BestDistanceSquared);
+		if (IsBetter) {
+			Best = Tank;
+			BestScore = Score;
+			BestDistanceSquared = DistanceSquared;
+		}
+	}
+
+	Targets[Index] = Best;
+
+	// Nothing in range thinks every ThinkMaxFrames, a tank right on top of us every ThinkMinFrames.
+	const int32 MinFrames = FMath::Max(CVarTurretThinkMinFrames.GetValueOnGameThread(), 1);
+	const int32 MaxFrames = FMath::Max(CVarTurretThinkMaxFrames.GetValueOnGameThread(), MinFrames);
+	// 0 with a tank right on top of us, 1 at the edge of ThreatRange (or with nothing in it).
+	const float Distance = FMath::Sqrt(NearestDistanceSquared / FMath::Max(ThreatRangesSquared[Index], 1.f));
+	NextThinkFrames[Index] = ThinkFrame + FMath::RoundToInt(FMath::Lerp<float>(MinFrames, MaxFrames, Distance));
+}
+
+// -------------------------------------------------------------------------------------------
+/// The class default object gets constructed like any other, but it should never tick.
+ETickableTickType UTurretManagerSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+// -------------------------------------------------------------------------------------------
+bool UTurretManagerSubsystem::IsTickable() const
+{
+	return Turrets.Num() > 0 && GetWorld()->GetNetMode() != NM_Client;
+}
+
+// -------------------------------------------------------------------------------------------
+UWorld* UTurretManagerSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+// -------------------------------------------------------------------------------------------
+TStatId UTurretManagerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTurretManagerSubsystem, STATGROUP_Tickables);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Add Turret to the end of every array, and remember where we put it.
+void UTurretManagerSubsystem::RegisterTurret(APawnTurret* Turret, float ThreatRange)
+{
+	if (!Turret || Turret->ManagerIndex != INDEX_NONE) {
+		return;
+	}
+
+	const FVector Location = Turret->GetActorLocation();
+	UBallisticsSubsystem* Ballistics = GetWorld()->GetSubsystem<UBallisticsSubsystem>();
+
+	Turret->ManagerIndex = Turrets.Add(Turret);
+	Targets.Add(nullptr);
+	PositionsX.Add(Location.X);
+	PositionsY.Add(Location.Y);
+	PositionsZ.Add(Location.Z);
+	ThreatRangesSquared.Add(ThreatRange * ThreatRange);
+	Yaws.Add(Turret->GetAimDirection().Rotation().Yaw);
+	AppliedYaws.Add(Yaws.Last());
+	TurnRates.Add(Turret->GetTurnRate());
+	LaunchPitches.Add(0);
+	InRange.Add(false);
+	OnTarget.Add(false);
+	Awake.Add(false);
+	TargetPolicies.Add(static_cast<uint8>(Turret->GetTargetPolicy()));
+	TargetsX.Add(0);
+	TargetsY.Add(0);
+	TargetsZ.Add(0);
+	HasTarget.Add(false);
+	TargetVelocitiesX.Add(0);
+	TargetVelocitiesY.Add(0);
+	NextThinkFrames.Add(0);
+	// Turrets only turn, so the muzzle never changes height, and stays the same distance forward of the turret.
+	const FVector Muzzle = Turret->GetMuzzleLocation();
+	const FVector MuzzleOffset = FRotator(0, -Yaws.Last(), 0).RotateVector(Muzzle - Location);
+	MuzzlesZ.Add(Muzzle.Z);
+	MuzzleForwards.Add(MuzzleOffset.X);
+	MuzzleRights.Add(MuzzleOffset.Y);
+	BallisticTables.Add(Ballistics ? Ballistics->GetTable(Turret->GetProjectileClass()) : nullptr);
+}
+
+// -------------------------------------------------------------------------------------------
+/// Remove Turret by swapping the last turret into its slot, so removal is O(1) and the arrays stay packed.
+void UTurretManagerSubsystem::UnregisterTurret(APawnTurret* Turret)
+{
+	if (!Turret || !Turrets.IsValidIndex(Turret->ManagerIndex) || Turrets[Turret->ManagerIndex] != Turret) {
+		return;
+	}
+
+	const int32 Index = Turret->ManagerIndex;
+	Turrets.RemoveAtSwap(Index, 1, false);
+	Targets.RemoveAtSwap(Index, 1, false);
+	PositionsX.RemoveAtSwap(Index, 1, false);
+	PositionsY.RemoveAtSwap(Index, 1, false);
+	PositionsZ.RemoveAtSwap(Index, 1, false);
+	ThreatRangesSquared.RemoveAtSwap(Index, 1, false);
+	Yaws.RemoveAtSwap(Index, 1, false);
+	AppliedYaws.RemoveAtSwap(Index, 1, false);
+	TurnRates.RemoveAtSwap(Index, 1, false);
+	LaunchPitches.RemoveAtSwap(Index, 1, false);
+	InRange.RemoveAtSwap(Index, 1, false);
+	OnTarget.RemoveAtSwap(Index, 1, false);
+	Awake.RemoveAtSwap(Index, 1, false);
+	TargetPolicies.RemoveAtSwap(Index, 1, false);
+	TargetsX.RemoveAtSwap(Index, 1, false);
+	TargetsY.RemoveAtSwap(Index, 1, false);
+	TargetsZ.RemoveAtSwap(Index, 1, false);
+	HasTarget.RemoveAtSwap(Index, 1, false);
+	TargetVelocitiesX.RemoveAtSwap(Index, 1, false);
+	TargetVelocitiesY.RemoveAtSwap(Index, 1, false);
+	NextThinkFrames.RemoveAtSwap(Index, 1, false);
+	MuzzlesZ.RemoveAtSwap(Index, 1, false);
+	MuzzleForwards.RemoveAtSwap(Index, 1, false);
+	MuzzleRights.RemoveAtSwap(Index, 1, false);
+	BallisticTables.RemoveAtSwap(Index, 1, false);
+
+	// Whoever got swapped into our old slot needs to know their new index.
+	if (Turrets.IsValidIndex(Index) && Turrets[Index]) {
+		Turrets[Index]->ManagerIndex = Index;
+	}
+	Turret->ManagerIndex = INDEX_NONE;
+}
+
+// -------------------------------------------------------------------------------------------
+bool UTurretManagerSubsystem::IsTargetInRange(const APawnTurret* Turret) const
+{
+	if (!Turret || !InRange.IsValidIndex(Turret->ManagerIndex)) {
+		return false;
+	}
+	return InRange[Turret->ManagerIndex] != 0;
+}
+
+// -------------------------------------------------------------------------------------------
+bool UTurretManagerSubsystem::IsReadyToFire(const APawnTurret* Turret) const
+{
+	if (!Turret || !OnTarget.IsValidIndex(Turret->ManagerIndex)) {
+		return false;
+	}
+	return OnTarget[Turret->ManagerIndex] != 0;
+}
+
+// -------------------------------------------------------------------------------------------
+APawnTank* UTurretManagerSubsystem::GetTarget(const APawnTurret* Turret) const
+{
+	if (!Turret || !Targets.IsValidIndex(Turret->ManagerIndex)) {
+		return nullptr;
+	}
+	return Targets[Turret->ManagerIndex];
+}
+
+// -------------------------------------------------------------------------------------------
+/// One pass to grab where every turret's target is this frame, one pass over plain floats to see
+/// which targets are in range, and one pass to wake up the turrets whose target just came in range and
+/// sleep the ones whose target just left. Then the turrets in range work out their aim and turn towards it,
+/// all on plain arrays so it can run on worker threads, and last the ones that turned far enough get moved.
+void UTurretManagerSubsystem::UpdateAim(UPawnSpatialGridSubsystem* SpatialGrid, float DeltaTime)
+{
+	const int32 Num = Turrets.Num();
+
+	// A target that died (or is gone) gets replaced right away, instead of waiting for the turret's slice.
+	for (int32 Index = 0; Index < Num; Index++) {
+		APawnTank* Target = Targets[Index];
+		if (Target && (!IsValid(Target) || !Target->IsPlayerAlive())) {
+			SelectTarget(Index, SpatialGrid);
+			Target = Targets[Index];
+		}
+
+		HasTarget[Index] = Target != nullptr;
+		if (Target) {
+			const FVector Location = Target->GetActorLocation();
+			const FVector Velocity = Target->GetVelocity();
+			TargetsX[Index] = Location.X;
+			TargetsY[Index] = Location.Y;
+			TargetsZ[Index] = Location.Z;
+			TargetVelocitiesX[Index] = Velocity.X;
+			TargetVelocitiesY[Index] = Velocity.Y;
+		}
+	}
+
+	const float* RESTRICT X = PositionsX.GetData();
+	const float* RESTRICT Y = PositionsY.GetData();
+	const float* RESTRICT Z = PositionsZ.GetData();
+	const float* RESTRICT TargetX = TargetsX.GetData();
+	const float* RESTRICT TargetY = TargetsY.GetData();
+	const float* RESTRICT TargetZ = TargetsZ.GetData();
+	const float* RESTRICT RangeSquared = ThreatRangesSquared.GetData();
+	const uint8* RESTRICT HasTargetFlags = HasTarget.GetData();
+	uint8* RESTRICT InRangeFlags = InRange.GetData();
+	uint8* RESTRICT AwakeFlags = Awake.GetData();
+
+	// No branches or sqrt in here, so the compiler is free to vectorize it.
+	for (int32 Index = 0; Index < Num; Index++) {
+		const float DeltaX = TargetX[Index] - X[Index];
+		const float DeltaY = TargetY[Index] - Y[Index];
+		const float DeltaZ = TargetZ[Index] - Z[Index];
+		const float DistanceSquared = DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ;
+		InRangeFlags[Index] = HasTargetFlags[Index] & (DistanceSquared <= RangeSquared[Index]);
+	}
+
+	for (int32 Index = 0; Index < Num; Index++) {
+		if (InRangeFlags[Index] != AwakeFlags[Index]) {
+			AwakeFlags[Index] = InRangeFlags[Index];
+			if (InRangeFlags[Index]) {
+				Turrets[Index]->Wake();
+			}
+			else {
+				Turrets[Index]->Sleep();
+			}
+		}
+	}
+
+	// Turrets only look left and right, so the aim is the yaw towards the target on the XY plane.
+	// With a ballistic table, that's towards where the target will be when the shot lands, and we lob it at the
+	// table's pitch. Tanks drive on the ground, so we only lead them sideways.
+	// Each turret only touches its own slot in the arrays (the tables are read only), so this is safe to split up.
+	// A turret that's still turning holds fire (the launch pitch is for the aim, not for where it's pointing yet).
+	const bool LeadTargets = CVarTurretLeadTargets.GetValueOnGameThread();
+	const float FireCone = CVarTurretFireConeDegrees.GetValueOnGameThread();
+	ParallelFor(Num, [&](int32 Index)
+	{
+		if (!InRangeFlags[Index]) {
+			OnTarget[Index] = false;
+			return;
+		}
+
+		FVector AimPoint(TargetX[Index], TargetY[Index], TargetZ[Index]);
+		if (LeadTargets && BallisticTables[Index]) {
+			// The muzzle where the turret's pointing now, not the turret's middle, so the range is right.
+			float Sin, Cos;
+			FMath::SinCos(&Sin, &Cos, FMath::DegreesToRadians(Yaws[Index]));
+			const FVector Muzzle(
+				X[Index] + Cos * MuzzleForwards[Index] - Sin * MuzzleRights[Index],
+				Y[Index] + Sin * MuzzleForwards[Index] + Cos * MuzzleRights[Index],
+				MuzzlesZ[Index]);
+			FBallisticSolution Solution;
+			AimPoint = BallisticTables[Index]->LeadTarget(
+				Muzzle,
+				AimPoint,
+				FVector(TargetVelocitiesX[Index], TargetVelocitiesY[Index], 0),
+				OUT Solution);
+			LaunchPitches[Index] = Solution.Pitch;
+		}
+
+		// Turn the short way round, no further than TurnRate allows this frame.
+		const float AimYaw = FMath::RadiansToDegrees(FMath::Atan2(AimPoint.Y - Y[Index], AimPoint.X - X[Index]));
+		const float Delta = FMath::FindDeltaAngleDegrees(Yaws[Index], AimYaw);
+		const float MaxTurn = TurnRates[Index] > 0 ? TurnRates[Index] * DeltaTime : BIG_NUMBER;
+		Yaws[Index] = FRotator::NormalizeAxis(Yaws[Index] + FMath::Clamp(Delta, -MaxTurn, MaxTurn));
+		OnTarget[Index] = FMath::Abs(FMath::FindDeltaAngleDegrees(Yaws[Index], AimYaw)) <= FireCone;
+	}, Num < CVarTurretParallelAimMin.GetValueOnGameThread());
+
+	// Back on the game thread, hand the results to the turrets. Moving the mesh is what costs (it updates
+	// the ProjectileSpawnPoint under it too), so turrets that have barely turned keep their transform.
+	const float MinYawChange = CVarTurretMinYawChange.GetValueOnGameThread();
+	int32 NumRotations = 0;
+	for (int32 Index = 0; Index < Num; Index++) {
+		if (!InRangeFlags[Index]) {
+			continue;
+		}
+
+		if (LeadTargets && BallisticTables[Index]) {
+			Turrets[Index]->SetLaunchPitch(LaunchPitches[Index]);
+		}
+		else if (BallisticTables[Index]) {
+			Turrets[Index]->ClearLaunchPitch();
+		}
+
+		if (FMath::Abs(FMath::FindDeltaAngleDegrees(AppliedYaws[Index], Yaws[Index])) >= MinYawChange) {
+			AppliedYaws[Index] = Yaws[Index];
+			Turrets[Index]->SetTurretYaw(Yaws[Index]);
+			NumRotations++;
+		}
+	}
+
+	TOONTANKS_COUNT(TurretRotations, NumRotations);
+}
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+
+#include "TurretManagerSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class APawnBase;
+class APawnTank;
+class APawnTurret;
+class UPawnSpatialGridSubsystem;
+struct FBallisticTable;
+
+// -------------------------------------------------------------------------------------------
+/**
+ * The registry of every live turret in the World, and does the aiming for all of them,
+ * so the turrets themselves don't need to Tick. \n
+ * Turret state is kept as a "struct of arrays" (one array per value, all indexed the same),
+ * so the per-frame pass is one tight loop over plain floats instead of one virtual Tick() per turret. \n
+ * It's also what wakes turrets up: a turret only runs its fire timer between the pass where the target
+ * comes into its ThreatRange and the pass where it leaves, so idle turrets cost nothing but their slot here. \n
+ * Each turret has one target tank, picked with the PawnSpatialGridSubsystem by the turret's TargetPolicy.
+ * Picking a target is the turret's "think", and it's time sliced: every frame we think for the turrets
+ * that are due until ToonTanks.Turrets.ThinkBudgetUs runs out, and carry on from there next frame.
+ * On a fixed timestep the budget is ToonTanks.Turrets.ThinksPerStep thinks instead, so it doesn't depend on machine load.
+ * Turrets close to a tank are due again after ThinkMinFrames, ones with nothing around after ThinkMaxFrames.
+ * A turret whose target just died thinks straight away. \n
+ * Turrets lead their target: they aim where it'll be when the shot lands, with a UBallisticsSubsystem table lookup. \n
+ * They don't snap to it though, they turn towards it at their TurnRate. The aim and turn for every turret are
+ * worked out in a ParallelFor over the arrays, and written back to the turret meshes in one pass afterwards,
+ * skipping any turret that moved less than ToonTanks.Turrets.MinYawChange (no transform update for it at all).
+ * A turret only fires once it's turned to within ToonTanks.Turrets.FireConeDegrees of its aim.
+ */
+UCLASS()
+class TOONTANKS_API UTurretManagerSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+
+	// ---------------------------------------------------------
+	/// Start aiming Turret. Turrets don't move, so we grab their location once here.
+	void RegisterTurret(APawnTurret* Turret, float ThreatRange);
+	/// Stop aiming Turret (it died, or the level is going away).
+	void UnregisterTurret(APawnTurret* Turret);
+	/// Whether the target was within Turret's ThreatRange on the last aiming pass.
+	bool IsTargetInRange(const APawnTurret* Turret) const;
+	/// In range, and Turret has turned to within ToonTanks.Turrets.FireConeDegrees of its aim. What it fires on.
+	bool IsReadyToFire(const APawnTurret* Turret) const;
+	/// The tank Turret is currently after (in range or not). Null if it has none.
+	APawnTank* GetTarget(const APawnTurret* Turret) const;
+
+	/// How many turrets are still alive. Cheap enough to check on every death.
+	int32 GetNumTurrets() const { return Turrets.Num(); }
+	/// Every live turret, packed with no gaps. Don't hold on to this across frames,
+	/// since turrets get swapped around as others die.
+	const TArray<APawnTurret*>& GetTurrets() const { return Turrets; }
+
+private:
+	// ---------------------------------------------------------
+	/// Pick targets and aim at them. Called from Tick, or from every fixed step when the SimulationClock is on.
+	void UpdateTurrets(float DeltaTime);
+	/// Pick new targets for the turrets that are due, until this frame's think budget runs out.
+	void ThinkWithinBudget(UPawnSpatialGridSubsystem* SpatialGrid);
+	/// Pick the best tank in range of the turret at Index, by its TargetPolicy, and schedule its next think.
+	void SelectTarget(int32 Index, UPawnSpatialGridSubsystem* SpatialGrid);
+	void UpdateAim(UPawnSpatialGridSubsystem* SpatialGrid, float DeltaTime);
+
+	bool IsFixedStep = false;
+
+	UPROPERTY()
+	TArray<APawnTurret*> Turrets;
+	/// Lines up with Turrets too. A UPROPERTY so destroyed tanks get nulled out.
+	UPROPERTY()
+	TArray<APawnTank*> Targets;
+
+	// Everything below lines up with Turrets by index.
+	TArray<float> PositionsX;
+	TArray<float> PositionsY;
+	TArray<float> PositionsZ;
+	TArray<float> ThreatRangesSquared;
+	/// Where the turret is pointing now (turning towards its target at TurnRates).
+	TArray<float> Yaws;
+	/// What we last gave SetTurretYaw(), so tiny changes can skip the transform update.
+	TArray<float> AppliedYaws;
+	/// Degrees per second, 0 to snap.
+	TArray<float> TurnRates;
+	/// Worked out in the parallel part of UpdateAim(), handed to the turret in the write back.
+	TArray<float> LaunchPitches;
+	TArray<uint8> InRange;
+	/// In range and pointing within the fire cone of the aim, as of the last aiming pass.
+	TArray<uint8> OnTarget;
+	/// InRange as of the last time we woke or slept the turret, so we only call it on changes.
+	TArray<uint8> Awake;
+	/// ETurretTargetPolicy, copied from the turret when it registers.
+	TArray<uint8> TargetPolicies;
+	// The target's location as of this frame, filled in at the start of UpdateAim().
+	TArray<float> TargetsX;
+	TArray<float> TargetsY;
+	TArray<float> TargetsZ;
+	TArray<uint8> HasTarget;
+	TArray<float> TargetVelocitiesX;
+	TArray<float> TargetVelocitiesY;
+	/// ThinkFrame at which the turret picks a target again.
+	TArray<uint32> NextThinkFrames;
+	/// Where our shots start from, height wise. Ballistic tables are by height above (or below) the muzzle.
+	TArray<float> MuzzlesZ;
+	/// Where the muzzle is from our location, forward and right of where the turret's pointing.
+	/// The muzzle swings round with the turret, so its XY is worked out from these and the yaw.
+	TArray<float> MuzzleForwards;
+	TArray<float> MuzzleRights;
+	/// For our ProjectileClass, from the UBallisticsSubsystem. Null if it has none (no class, or it doesn't fall).
+	TArray<const FBallisticTable*> BallisticTables;
+
+	/// Where the next ThinkWithinBudget() starts.
+	int32 ThinkCursor = 0;
+	/// Counts UpdateTurrets() calls (frames, or fixed steps).
+	uint32 ThinkFrame = 0;
+	/// Scratch space for SelectTarget(), kept around so we don't allocate every time.
+	TArray<APawnBase*> Candidates;
+};
@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponDefinitionSubsystem.h"
+
+#include "Misc/FileHelper.h"
+#include "Serialization/Csv/CsvParser.h"
+#include "ToonTanks/Actors/ProjectileBase.h"
+#define OUT
+
+const FName UWeaponDefinitionSubsystem::DefaultWeaponName(TEXT("Default"));
+
+// -------------------------------------------------------------------------------------------
+/// Type "ToonTanks.Weapons.Stats" in the console to list every weapon and its id.
+static FAutoConsoleCommandWithWorld WeaponStatsCommand(
+	TEXT("ToonTanks.Weapons.Stats"),
+	TEXT("Print every weapon definition for the current world."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UWeaponDefinitionSubsystem* Weapons = World ? World->GetSubsystem<UWeaponDefinitionSubsystem>() : nullptr) {
+			Weapons->LogStats();
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+/// "ToonTanks.Weapons.ReloadCsv <file>" swaps in new weapon numbers while the game is running.
+static FAutoConsoleCommandWithWorldAndArgs WeaponReloadCsvCommand(
+	TEXT("ToonTanks.Weapons.ReloadCsv"),
+	TEXT("Replace the weapon table's rows with a CSV file's (same columns as FWeaponTableRow), in any build. Takes effect on the next shot."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UWeaponDefinitionSubsystem* Weapons = World ? World->GetSubsystem<UWeaponDefinitionSubsystem>() : nullptr;
+		if (Weapons && Args.Num() > 0) {
+			Weapons->ReloadFromCsv(Args[0]);
+		}
+	}));
+
+// -------------------------------------------------------------------------------------------
+/// Same fields, minus everything the DataTable row needs that we don't.
+static FWeaponDefinition ToDefinition(const FWeaponTableRow& Row)
+{
+	FWeaponDefinition Definition;
+	Definition.Damage = Row.Damage;
+	Definition.MoveSpeedStart = Row.MoveSpeedStart;
+	Definition.MoveSpeedMax = Row.MoveSpeedMax;
+	Definition.LifeSpan = Row.LifeSpan;
+	Definition.ExplosionTimer = Row.ExplosionTimer;
+	Definition.ImpulseRadius = Row.ImpulseRadius;
+	Definition.ImpulseForce = Row.ImpulseForce;
+	Definition.SplashDamage = Row.SplashDamage;
+	Definition.SplashMinDamage = Row.SplashMinDamage;
+	Definition.SplashInnerRadius = Row.SplashInnerRadius;
+	Definition.SplashRadius = Row.SplashRadius;
+	Definition.SplashFalloff = Row.SplashFalloff;
+	return Definition;
+}
+
+// -------------------------------------------------------------------------------------------
+void UWeaponDefinitionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Id 0, for projectiles with no weapon set, or one that isn't in the table.
+	WeaponIds.Add(DefaultWeaponName, 0);
+	WeaponNames.Add(DefaultWeaponName);
+	Weapons.AddDefaulted();
+	IsInTable.Add(false);
+
+	LoadedWeaponTable = WeaponTable.LoadSynchronous();
+	if (LoadedWeaponTable) {
+		const UScriptStruct* RowStruct = LoadedWeaponTable->GetRowStruct();
+		if (!RowStruct || !RowStruct->IsChildOf(FWeaponTableRow::StaticStruct())) {
+			UE_LOG(LogTemp, Warning, TEXT("Weapons: %s doesn't use FWeaponTableRow, ignoring it."), *LoadedWeaponTable->GetName());
+			LoadedWeaponTable = nullptr;
+		}
+		else {
+			// Fires when the table is edited or reimported in the editor.
+			TableChangedHandle = LoadedWeaponTable->OnDataTableChanged().AddUObject(this, &UWeaponDefinitionSubsystem::Rebuild);
+		}
+	}
+	Rebuild();
+}
+
+// -------------------------------------------------------------------------------------------
+void UWeaponDefinitionSubsystem::Deinitialize()
+{
+	if (LoadedWeaponTable) {
+		LoadedWeaponTable->OnDataTableChanged().Remove(TableChangedHandle);
+	}
+	LoadedWeaponTable = nullptr;
+	OnWeaponsChanged.Clear();
+	// Weapons stays as it is, so anything asking on its way out still gets an answer from GetWeapon().
+	Super::Deinitialize();
+}
+
+// -------------------------------------------------------------------------------------------
+int32 UWeaponDefinitionSubsystem::FindWeaponId(FName WeaponName) const
+{
+	const int32* WeaponId = WeaponIds.Find(WeaponName);
+	return WeaponId ? *WeaponId : 0;
+}
+
+// -------------------------------------------------------------------------------------------
+/// Only seeds a weapon the first time its name comes up. After that a table row with the same name wins.
+int32 UWeaponDefinitionSubsystem::FindWeaponId(const AProjectileBase* Projectile)
+{
+	if (!Projectile) {
+		return 0;
+	}
+	const FName WeaponName = Projectile->GetWeaponName().IsNone() ? Projectile->GetClass()->GetFName() : Projectile->GetWeaponName();
+	if (const int32* WeaponId = WeaponIds.Find(WeaponName)) {
+		return *WeaponId;
+	}
+
+	const int32 WeaponId = Weapons.Add(Projectile->GetFallbackWeapon());
+	WeaponIds.Add(WeaponName, WeaponId);
+	WeaponNames.Add(WeaponName);
+	IsInTable.Add(false);
+	UE_LOG(LogTemp, Log, TEXT("Weapons: no %s row in %s, using %s's fallback properties."),
+		*WeaponName.ToString(), *GetNameSafe(LoadedWeaponTable), *Projectile->GetClass()->GetName());
+	return WeaponId;
+}
+
+// -------------------------------------------------------------------------------------------
+const FWeaponDefinition& UWeaponDefinitionSubsystem::GetWeapon(int32 WeaponId) const
+{
+	return Weapons.IsValidIndex(WeaponId) ? Weapons[WeaponId] : Weapons[0];
+}
+
+// -------------------------------------------------------------------------------------------
+/// Rows we've seen before overwrite their old slot, new rows go on the end.
+void UWeaponDefinitionSubsystem::ApplyRow(FName WeaponName, const FWeaponTableRow& Row)
+{
+	// A "Default" row retunes the default weapon.
+	const int32* ExistingId = WeaponIds.Find(WeaponName);
+	const int32 WeaponId = ExistingId ? *ExistingId : Weapons.AddDefaulted();
+	if (!ExistingId) {
+		WeaponIds.Add(WeaponName, WeaponId);
+		WeaponNames.Add(WeaponName);
+		IsInTable.Add(false);
+	}
+	Weapons[WeaponId] = ToDefinition(Row);
+	IsInTable[WeaponId] = true;
+}
+
+// -------------------------------------------------------------------------------------------
+void UWeaponDefinitionSubsystem::Rebuild()
+{
+	for (int32 WeaponId = 1; WeaponId < IsInTable.Num(); WeaponId++) {
+		IsInTable[WeaponId] = false;
+	}
+
+	if (LoadedWeaponTable) {
+		for (const TPair<FName, uint8*>& Row : LoadedWeaponTable->GetRowMap()) {
+			ApplyRow(Row.Key, *reinterpret_cast<const FWeaponTableRow*>(Row.Value));
+		}
+	}
+
+	OnWeaponsChanged.Broadcast();
+}
+
+// -------------------------------------------------------------------------------------------
+/// First line is the header: the row name column (whatever it's called), then FWeaponTableRow property names,
+/// in any order. Columns we don't know are skipped, and fields a row leaves out keep FWeaponTableRow's defaults.
+bool UWeaponDefinitionSubsystem::ReloadFromCsv(const FString& Path)
+{
+	FString Csv;
+	if (!FFileHelper::LoadFileToString(OUT Csv, *Path)) {
+		UE_LOG(LogTemp, Warning, TEXT("Weapons: couldn't read %s"), *Path);
+		return false;
+	}
+
+	const FCsvParser Parser(Csv);
+	const FCsvParser::FRows& Rows = Parser.GetRows();
+	if (Rows.Num() < 2) {
+		UE_LOG(LogTemp, Warning, TEXT("Weapons: %s has no rows, keeping the weapons we have."), *Path);
+		return false;
+	}
+
+	// Which property each column goes into. Null for the name column and for anything we don't know.
+	const UScriptStruct* RowStruct = FWeaponTableRow::StaticStruct();
+	TArray<const FProperty*> Columns;
+	for (int32 Column = 0; Column < Rows[0].Num(); Column++) {
+		const FProperty* Property = Column > 0 ? RowStruct->FindPropertyByName(FName(Rows[0][Column])) : nullptr;
+		if (Column > 0 && !Property) {
+			UE_LOG(LogTemp, Warning, TEXT("Weapons: %s has no %s, skipping that column."), *RowStruct->GetName(), Rows[0][Column]);
+		}
+		Columns.Add(Property);
+	}
+
+	for (int32 WeaponId = 1; WeaponId < IsInTable.Num(); WeaponId++) {
+		IsInTable[WeaponId] = false;
+	}
+	int32 NumRows = 0;
+	for (int32 RowIndex = 1; RowIndex < Rows.Num(); RowIndex++) {
+		const TArray<const TCHAR*>& Cells = Rows[RowIndex];
+		if (Cells.Num() == 0 || FCString::Strlen(Cells[0]) == 0) {
+			continue;
+		}
+
+		FWeaponTableRow Row;
+		for (int32 Column = 1; Column < FMath::Min(Cells.Num(), Columns.Num()); Column++) {
+			const FProperty* Property = Columns[Column];
+			if (Property && !Property->ImportText(Cells[Column], Property->ContainerPtrToValuePtr<void>(&Row), PPF_None, nullptr)) {
+				UE_LOG(LogTemp, Warning, TEXT("Weapons: bad %s \"%s\" for %s"), *Property->GetName(), Cells[Column], Cells[0]);
+			}
+		}
+		ApplyRow(FName(Cells[0]), Row);
+		NumRows++;
+	}
+
+	OnWeaponsChanged.Broadcast();
+	UE_LOG(LogTemp, Log, TEXT("Weapons: reloaded %d rows from %s"), NumRows, *Path);
+	return true;
+}
+
+// -------------------------------------------------------------------------------------------
+void UWeaponDefinitionSubsystem::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Weapons: %d from %s"), Weapons.Num(), *GetNameSafe(LoadedWeaponTable));
+	for (int32 WeaponId = 0; WeaponId < Weapons.Num(); WeaponId++) {
+		const FWeaponDefinition& Weapon = Weapons[WeaponId];
+		UE_LOG(LogTemp, Log, TEXT("  %2d %-16s%s damage %.0f, speed %.0f-%.0f, life %.1f, fuse %.1f, impulse %.0f/%.0f, splash %.0f-%.0f/%.0f-%.0f^%.1f"),
+			WeaponId,
+			*WeaponNames[WeaponId].ToString(),
+			WeaponId > 0 && !IsInTable[WeaponId] ? TEXT(" (not in table)") : TEXT(""),
+			Weapon.Damage,
+			Weapon.MoveSpeedStart,
+			Weapon.MoveSpeedMax,
+			Weapon.LifeSpan,
+			Weapon.ExplosionTimer,
+			Weapon.ImpulseRadius,
+			Weapon.ImpulseForce,
+			Weapon.SplashDamage,
+			Weapon.SplashMinDamage,
+			Weapon.SplashInnerRadius,
+			Weapon.SplashRadius,
+			Weapon.SplashFalloff);
+	}
+}
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "WeaponDefinitionSubsystem.generated.h"
+
+// -------------------------------------------------------------------------------------------
+// Forward declarations.
+class AProjectileBase;
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Everything a projectile needs to know about the weapon that fired it, as plain floats. \n
+ * This is what the game reads at runtime: one packed array of these, indexed by weapon id.
+ * The defaults are the old AProjectileBase defaults, and what the "Default" weapon gets.
+ */
+struct FWeaponDefinition
+{
+	float Damage = 50;
+	float MoveSpeedStart = 500;
+	float MoveSpeedMax = 3000;
+	/// Seconds before an unexploded projectile goes back to the pool is LifeSpan * 2.
+	float LifeSpan = 5;
+	/// Seconds from the first bounce to the explosion.
+	float ExplosionTimer = 2.5f;
+	float ImpulseRadius = 500;
+	float ImpulseForce = 2000;
+	/// Damage to every pawn caught in the explosion, falling off from SplashInnerRadius out to SplashRadius
+	/// (see FSplashDamage). 0 means no splash, just the direct hit.
+	float SplashDamage = 0;
+	float SplashMinDamage = 0;
+	float SplashInnerRadius = 0;
+	/// 0 means as far as ImpulseRadius.
+	float SplashRadius = 0;
+	float SplashFalloff = 1;
+};
+
+// -------------------------------------------------------------------------------------------
+/// One row of the weapon DataTable, the row name being the weapon's name. Same fields as FWeaponDefinition.
+USTRUCT(BlueprintType)
+struct FWeaponTableRow : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Damage")
+	float Damage = 50;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Movement")
+	float MoveSpeedStart = 500;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Movement")
+	float MoveSpeedMax = 3000;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Life")
+	float LifeSpan = 5;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Life")
+	float ExplosionTimer = 2.5f;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Explosion")
+	float ImpulseRadius = 500;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Explosion")
+	float ImpulseForce = 2000;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Splash")
+	float SplashDamage = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Splash")
+	float SplashMinDamage = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Splash")
+	float SplashInnerRadius = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Splash")
+	float SplashRadius = 0;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Splash", meta=(ClampMin="0"))
+	float SplashFalloff = 1;
+};
+
+// -------------------------------------------------------------------------------------------
+DECLARE_MULTICAST_DELEGATE(FOnWeaponsChanged);
+
+// -------------------------------------------------------------------------------------------
+/**
+ * Flattens the weapon DataTable (WeaponTable in DefaultGame.ini) into a packed array of FWeaponDefinition,
+ * so a projectile in flight only needs its weapon id, and reading its tuning is one array index. \n
+ * Id 0 is always the built-in "Default" weapon. Table rows get ids in the order we first see them,
+ * and keep them for as long as the World is around, so hot reloading never invalidates an id:
+ * edit the table in the editor (or "ToonTanks.Weapons.ReloadCsv <file>" in any build) and every
+ * projectile launched after that uses the new numbers. No pawns or projectiles need respawning.
+ */
+UCLASS(Config=Game)
+class TOONTANKS_API UWeaponDefinitionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// ---------------------------------------------------------
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// The id of the weapon called WeaponName, or 0 (the default weapon) if there's no such row.
+	int32 FindWeaponId(FName WeaponName) const;
+	/// The id of Projectile's weapon. If its WeaponName isn't in the table (or there's no table at all), it gets
+	/// a weapon of its own, seeded from its class's fallback properties, so projectiles tuned before the table
+	/// existed still fly the way they were tuned. That weapon is named after the WeaponName, or the class if it has none.
+	int32 FindWeaponId(const AProjectileBase* Projectile);
+	/// Bad ids get the default weapon, so this is always safe to call.
+	const FWeaponDefinition& GetWeapon(int32 WeaponId) const;
+	/// Copy the table into our array again, keeping existing ids. Called whenever the table changes.
+	void Rebuild();
+	/// Use the rows of a CSV file (same columns as FWeaponTableRow) instead of the table's, keeping existing ids.
+	/// Parsed here rather than through the DataTable, whose CSV import is editor only, so it works in packaged builds.
+	/// The next change to the table itself (editor only) puts the table's rows back.
+	bool ReloadFromCsv(const FString& Path);
+	void LogStats() const;
+
+	/// Broadcast after every Rebuild() or ReloadFromCsv(), for anything that caches values worked out from weapons.
+	FOnWeaponsChanged OnWeaponsChanged;
+
+	static const FName DefaultWeaponName;
+
+private:
+	// ---------------------------------------------------------
+	/// The DataTable of FWeaponTableRow to read weapons from. Without one, every projectile uses its fallback properties.
+	UPROPERTY(Config)
+	TSoftObjectPtr<UDataTable> WeaponTable;
+	UPROPERTY()
+	UDataTable* LoadedWeaponTable;
+	FDelegateHandle TableChangedHandle;
+
+	/// Give the row called WeaponName (a new id, or the one it had) Row's values.
+	void ApplyRow(FName WeaponName, const FWeaponTableRow& Row);
+
+	// All three line up by weapon id.
+	TArray<FWeaponDefinition> Weapons;
+	TArray<FName> WeaponNames;
+	/// False for weapons whose row was removed since they got their id, and for weapons seeded from
+	/// a projectile's fallback properties. They keep their last values.
+	TArray<bool> IsInTable;
+	TMap<FName, int32> WeaponIds;
+};
@@ -2,5 +2,38 @@
 
 #include "ToonTanks.h"
 #include "Modules/ModuleManager.h"
+#include "ToonTanksStats.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ToonTanks, "ToonTanks" );
+
+CSV_DEFINE_CATEGORY_MODULE(TOONTANKS_API, ToonTanks, true);
+
+DEFINE_STAT(STAT_ToonTanks_Fire);
+DEFINE_STAT(STAT_ToonTanks_ProjectileOnHit);
+DEFINE_STAT(STAT_ToonTanks_ExplosionImpulse);
+DEFINE_STAT(STAT_ToonTanks_ResolveExplosions);
+DEFINE_STAT(STAT_ToonTanks_TakeDamage);
+DEFINE_STAT(STAT_ToonTanks_TurretUpdate);
+DEFINE_STAT(STAT_ToonTanks_TankMove);
+DEFINE_STAT(STAT_ToonTanks_BallisticsBuild);
+DEFINE_STAT(STAT_ToonTanks_SceneQueryWait);
+DEFINE_STAT(STAT_ToonTanks_ProjectileSimulation);
+DEFINE_STAT(STAT_ToonTanks_Significance);
+
+DEFINE_STAT(STAT_ToonTanks_ProjectilesAlive);
+DEFINE_STAT(STAT_ToonTanks_SimulatedProjectiles);
+DEFINE_STAT(STAT_ToonTanks_SignificanceHigh);
+DEFINE_STAT(STAT_ToonTanks_SignificanceMedium);
+DEFINE_STAT(STAT_ToonTanks_SignificanceLow);
+DEFINE_STAT(STAT_ToonTanks_SignificanceDormant);
+DEFINE_STAT(STAT_ToonTanks_ProjectilesLaunched);
+DEFINE_STAT(STAT_ToonTanks_ProjectilesSpawned);
+DEFINE_STAT(STAT_ToonTanks_Sweeps);
+DEFINE_STAT(STAT_ToonTanks_DamageEvents);
+DEFINE_STAT(STAT_ToonTanks_TurretThinks);
+DEFINE_STAT(STAT_ToonTanks_TurretRotations);
+DEFINE_STAT(STAT_ToonTanks_SceneQueriesSync);
+DEFINE_STAT(STAT_ToonTanks_SceneQueriesAsync);
+DEFINE_STAT(STAT_ToonTanks_ExplosionsApproximated);
+DEFINE_STAT(STAT_ToonTanks_ExplosionsSkipped);
+DEFINE_STAT(STAT_ToonTanks_RepeatedHitsFiltered);
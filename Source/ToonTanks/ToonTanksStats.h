@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Stats/Stats.h"
+
+// -------------------------------------------------------------------------------------------
+/* Stats for our gameplay hot paths. Three ways to look at them:
+ *
+ *   "stat ToonTanks" in the console for the live numbers.
+ *   "csvprofile start" / "csvprofile stop" (or -csvCaptureFrames=N on the command line) for a CSV
+ *       under Saved/Profiling/CSV, with everything here in the ToonTanks category.
+ *   Unreal Insights (-trace=cpu) for per-frame timelines, which works from -nullrhi headless runs too.
+ *
+ * TOONTANKS_SCOPE_CYCLE(Name) feeds all three from one line, for a STAT_ToonTanks_<Name> cycle stat.
+ * TOONTANKS_COUNT(Name, Amount) adds to a per-frame STAT_ToonTanks_<Name> counter and its CSV stat.
+*/
+// -------------------------------------------------------------------------------------------
+
+DECLARE_STATS_GROUP(TEXT("ToonTanks"), STATGROUP_ToonTanks, STATCAT_Advanced);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(TOONTANKS_API, ToonTanks);
+
+// Cycle stats (time spent).
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pawn Fire"), STAT_ToonTanks_Fire, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Projectile OnHit"), STAT_ToonTanks_ProjectileOnHit, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Queue Explosion"), STAT_ToonTanks_ExplosionImpulse, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Resolve Explosions"), STAT_ToonTanks_ResolveExplosions, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Take Damage"), STAT_ToonTanks_TakeDamage, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Turret Update"), STAT_ToonTanks_TurretUpdate, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tank Move"), STAT_ToonTanks_TankMove, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Ballistics Build"), STAT_ToonTanks_BallisticsBuild, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Scene Query Wait"), STAT_ToonTanks_SceneQueryWait, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Projectile Simulation"), STAT_ToonTanks_ProjectileSimulation, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Significance"), STAT_ToonTanks_Significance, STATGROUP_ToonTanks, TOONTANKS_API);
+
+// Counters. Everything but ProjectilesAlive, SimulatedProjectiles and the Significance tiers resets each frame, so per second is the value times the frame rate.
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Projectiles Alive"), STAT_ToonTanks_ProjectilesAlive, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Simulated Projectiles"), STAT_ToonTanks_SimulatedProjectiles, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Significance: High"), STAT_ToonTanks_SignificanceHigh, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Significance: Medium"), STAT_ToonTanks_SignificanceMedium, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Significance: Low"), STAT_ToonTanks_SignificanceLow, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Significance: Dormant"), STAT_ToonTanks_SignificanceDormant, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Projectiles Launched"), STAT_ToonTanks_ProjectilesLaunched, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Projectiles Spawned"), STAT_ToonTanks_ProjectilesSpawned, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Sweeps"), STAT_ToonTanks_Sweeps, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Damage Events"), STAT_ToonTanks_DamageEvents, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Turret Thinks"), STAT_ToonTanks_TurretThinks, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Turret Rotations"), STAT_ToonTanks_TurretRotations, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Scene Queries (Sync)"), STAT_ToonTanks_SceneQueriesSync, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Scene Queries (Async)"), STAT_ToonTanks_SceneQueriesAsync, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Explosions Approximated"), STAT_ToonTanks_ExplosionsApproximated, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Explosions Skipped"), STAT_ToonTanks_ExplosionsSkipped, STATGROUP_ToonTanks, TOONTANKS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Repeated Hits Filtered"), STAT_ToonTanks_RepeatedHitsFiltered, STATGROUP_ToonTanks, TOONTANKS_API);
+
+/// Time this scope in "stat ToonTanks", the CSV profiler and Insights all at once.
+#define TOONTANKS_SCOPE_CYCLE(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_ToonTanks_##Name); \
+	CSV_SCOPED_TIMING_STAT(ToonTanks, Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(ToonTanks_##Name)
+
+/// Add Amount to this frame's counter, in "stat ToonTanks" and the CSV profiler.
+#define TOONTANKS_COUNT(Name, Amount) \
+	INC_DWORD_STAT_BY(STAT_ToonTanks_##Name, Amount); \
+	CSV_CUSTOM_STAT(ToonTanks, Name, static_cast<int32>(Amount), ECsvCustomStatOp::Accumulate)